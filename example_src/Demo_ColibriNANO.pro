@@ -30,8 +30,13 @@ UI_DIR      = tmp
 CONFIG += c++14
 
 #############################################################
+HEADERS += source/dsp/blockpool.h
+HEADERS += source/dsp/broadcastringbuffer.h
 HEADERS += source/dsp/fft.h
 HEADERS += source/dsp/spectrumringbuffer.h
+HEADERS += source/dsp/spscringbuffer.h
+HEADERS += source/dsp/stageprofiler.h
+HEADERS += source/dsp/streamallocator.h
 HEADERS += source/dsp/window.h
 
 #############################################################
@@ -44,14 +49,42 @@ FORMS   += source/gui/MainWindow.ui
 
 HEADERS += source/LibLoader/common.h
 HEADERS += source/LibLoader/LibLoader.h
+HEADERS += source/LibLoader/unpack.h
 SOURCES += source/LibLoader/LibLoader.cpp
 
+HEADERS += source/LibLoader/ThreadPolicy.h
+SOURCES += source/LibLoader/ThreadPolicy.cpp
+
+HEADERS += source/LibLoader/ControlQueue.h
+SOURCES += source/LibLoader/ControlQueue.cpp
+
+HEADERS += source/LibLoader/SessionManager.h
+SOURCES += source/LibLoader/SessionManager.cpp
+
 HEADERS += source/dsp/DspCore.h
 SOURCES += source/dsp/DspCore.cpp
 
+HEADERS += source/dsp/AdaptiveWait.h
+SOURCES += source/dsp/AdaptiveWait.cpp
+
+HEADERS += source/dsp/Pipeline.h
+SOURCES += source/dsp/Pipeline.cpp
+
+HEADERS += source/dsp/RingMemory.h
+SOURCES += source/dsp/RingMemory.cpp
+
 #############################################################
 include(libs/QCustomPlot/QCustomPlot.pri)
 
 linux {
     LIBS += -ldl
+
+    packagesExist(libusb-1.0) {
+        CONFIG    += link_pkgconfig
+        PKGCONFIG += libusb-1.0
+        DEFINES   += HAVE_LIBUSB
+
+        HEADERS += source/LibLoader/DeviceMonitor.h
+        SOURCES += source/LibLoader/DeviceMonitor.cpp
+    }
 }
@@ -0,0 +1,116 @@
+#include "ControlQueue.h"
+
+ControlQueue::ControlQueue(LibLoader &loader, Descriptor dev) :
+  m_loader(loader),
+  m_dev(dev)
+{
+    m_thread = thread(&ControlQueue::worker, this);
+}
+
+ControlQueue::~ControlQueue()
+{
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+        m_running = false;
+    }
+    m_cond.notify_all();
+
+    // queued requests are still applied before the thread exits
+    m_thread.join();
+}
+
+future<bool> ControlQueue::setFrequency(uint32_t value)
+{
+    return apply(ControlUpdate().setFrequency(value));
+}
+
+future<bool> ControlQueue::setPream(float value)
+{
+    return apply(ControlUpdate().setPream(value));
+}
+
+future<bool> ControlQueue::apply(const ControlUpdate &update)
+{
+    promise<bool> t_promise;
+    future<bool> t_future = t_promise.get_future();
+
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+
+        // merged in the order of the update, the setters keep the send order
+        const auto t_mergeFrequency = [this, &update] {
+            if (!update.hasFrequency)
+                return;
+            if (m_pending.hasFrequency)
+                ++m_coalesced;
+            m_pending.setFrequency(update.frequency);
+        };
+        const auto t_mergePreamp = [this, &update] {
+            if (!update.hasPreamp)
+                return;
+            if (m_pending.hasPreamp)
+                ++m_coalesced;
+            m_pending.setPream(update.preamp);
+        };
+
+        if (update.preampFirst) {
+            t_mergePreamp();
+            t_mergeFrequency();
+        }
+        else {
+            t_mergeFrequency();
+            t_mergePreamp();
+        }
+
+        m_promises.push_back(move(t_promise));
+    }
+    m_cond.notify_one();
+
+    return t_future;
+}
+
+void ControlQueue::flush()
+{
+    unique_lock<mutex> t_locker(m_mutex);
+    m_idleCond.wait(t_locker, [this] { return !m_busy && m_promises.empty(); });
+}
+
+uint64_t ControlQueue::coalesced() const noexcept
+{
+    return m_coalesced;
+}
+
+void ControlQueue::worker()
+{
+    unique_lock<mutex> t_locker(m_mutex);
+
+    while (true) {
+        m_cond.wait(t_locker, [this] { return !m_running || !m_promises.empty(); });
+
+        if (m_promises.empty())
+            break;
+
+        // take the whole pending state, requests arriving meanwhile form the next batch
+        const ControlUpdate t_update = m_pending;
+        vector<promise<bool>> t_promises;
+        t_promises.swap(m_promises);
+        m_pending = ControlUpdate();
+        m_busy = true;
+
+        t_locker.unlock();
+            bool t_result = true;
+            if (t_update.hasPreamp && t_update.preampFirst)
+                t_result = m_loader.setPream(m_dev, t_update.preamp) && t_result;
+            if (t_update.hasFrequency)
+                t_result = m_loader.setFrequency(m_dev, t_update.frequency) && t_result;
+            if (t_update.hasPreamp && !t_update.preampFirst)
+                t_result = m_loader.setPream(m_dev, t_update.preamp) && t_result;
+
+            for (auto &t_promise : t_promises)
+                t_promise.set_value(t_result);
+        t_locker.lock();
+
+        m_busy = false;
+        m_idleCond.notify_all();
+    }
+}
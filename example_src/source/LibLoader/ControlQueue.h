@@ -0,0 +1,95 @@
+#ifndef CONTROLQUEUE_H
+#define CONTROLQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LibLoader.h"
+
+using namespace std;
+
+/**
+ * \brief Set of receiver parameters applied together.
+ */
+struct ControlUpdate
+{
+    bool     hasFrequency { false };
+    uint32_t frequency    { 0 };      ///< tuning frequency, Hz
+    bool     hasPreamp    { false };
+    float    preamp       { 0 };      ///< gain/attenuation, dB
+    bool     preampFirst  { false };  ///< send order, the parameter set last is sent last
+
+    ControlUpdate &setFrequency(uint32_t value) { hasFrequency = true; frequency = value; preampFirst = hasPreamp; return *this; }
+    ControlUpdate &setPream(float value)        { hasPreamp = true; preamp = value; preampFirst = !hasFrequency; return *this; }
+};
+
+/**
+ * \brief Asynchronous control channel of one receiver.
+ *
+ * \details Every setFrequency()/setPream() of the library is a USB round trip, so the
+ * requests are executed by a worker thread and the caller gets a future. While a
+ * request is waiting, newer values of the same parameter replace it (latest value
+ * wins): dragging a knob sends only the last position instead of every step.
+ * Futures of the replaced requests are completed with the result of the request
+ * that carried the final value.
+ *
+ * Parameters of one apply() are sent back to back in the same batch, no other
+ * request of this queue is executed between them. Within a batch the parameters
+ * are sent in the order the caller set them, the one set last is sent last.
+ * LibLoader serialises the worker's calls with start()/stop() of other threads;
+ * call flush() before start() to have the queued values sent first.
+ */
+class ControlQueue
+{
+public:
+    ControlQueue(LibLoader &loader, Descriptor dev);
+    ~ControlQueue();
+
+    future<bool> setFrequency(uint32_t value);
+    future<bool> setPream(float value);
+
+    /**
+     * \brief Queue several parameters as one update.
+     * \return future completed when all of them are applied, true if all succeeded.
+     */
+    future<bool> apply(const ControlUpdate &update);
+
+    /**
+     * \brief Wait until all queued requests are applied.
+     */
+    void flush();
+
+    /**
+     * \brief Return amount of requests replaced by a newer value before being sent.
+     */
+    uint64_t coalesced() const noexcept;
+
+private:
+    ControlQueue(const ControlQueue &) = delete;
+    ControlQueue &operator=(const ControlQueue &) = delete;
+
+    void worker();
+
+private:
+    LibLoader  &m_loader;
+    Descriptor  m_dev;
+
+    mutex              m_mutex;
+    condition_variable m_cond;
+    condition_variable m_idleCond;
+
+    ControlUpdate          m_pending;
+    vector<promise<bool>>  m_promises;
+    bool                   m_busy    { false };
+    bool                   m_running { true };
+    atomic<uint64_t>       m_coalesced { 0 };
+
+    thread m_thread;
+};
+
+#endif // CONTROLQUEUE_H
@@ -0,0 +1,459 @@
+#include <cctype>
+
+#include "DeviceMonitor.h"
+
+constexpr uint16_t DeviceMonitor::VendorId;
+constexpr uint16_t DeviceMonitor::ProductId;
+constexpr const char *DeviceMonitor::ProductName;
+constexpr const char *DeviceMonitor::SerialPrefix;
+constexpr uint32_t DeviceMonitor::ResumeAttempts;
+constexpr chrono::milliseconds DeviceMonitor::ResumeRetryDelay;
+
+DeviceMonitor::DeviceMonitor(LibLoader &loader) :
+  m_loader(loader)
+{
+
+}
+
+DeviceMonitor::~DeviceMonitor()
+{
+    stop();
+}
+
+void DeviceMonitor::setCallback(pDeviceEvent p, void *pUserData)
+{
+    m_callback  = p;
+    m_pUserData = pUserData;
+}
+
+bool DeviceMonitor::start()
+{
+    if (m_thread.joinable())
+        return true;
+
+    if (libusb_init(&m_pContext) != 0) {
+        m_pContext = nullptr;
+        return false;
+    }
+
+    const int t_events = LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT;
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) ||
+        (libusb_hotplug_register_callback(m_pContext, static_cast<libusb_hotplug_event>(t_events),
+                                          LIBUSB_HOTPLUG_ENUMERATE,
+                                          VendorId, ProductId,
+                                          LIBUSB_HOTPLUG_MATCH_ANY, &DeviceMonitor::onHotplug,
+                                          this, &m_hotplug) != 0)) {
+        libusb_exit(m_pContext);
+        m_pContext = nullptr;
+        return false;
+    }
+
+    // LIBUSB_HOTPLUG_ENUMERATE queued the receivers already connected from the
+    // registration, they are known before start() returns
+    processEvents();
+
+    m_running = true;
+    m_thread  = thread(&DeviceMonitor::eventLoop, this);
+
+    return true;
+}
+
+void DeviceMonitor::stop()
+{
+    if (m_thread.joinable()) {
+        m_running = false;
+        libusb_interrupt_event_handler(m_pContext);
+        m_thread.join();
+    }
+
+    vector<Descriptor> t_devs;
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+
+        for (auto &session : m_sessions) {
+            if (session.second.dev)
+                t_devs.push_back(session.second.dev);
+        }
+        m_sessions.clear();
+
+        for (auto &device : m_devices)
+            libusb_unref_device(device.first);
+        m_devices.clear();
+    }
+
+    for (Descriptor dev : t_devs)
+        closeDevice(dev);
+
+    if (m_pContext) {
+        libusb_hotplug_deregister_callback(m_pContext, m_hotplug);
+
+        lock_guard<mutex> t_locker(m_eventsMutex);
+        for (const Event &event : m_events)
+            libusb_unref_device(event.pDevice);
+        m_events.clear();
+
+        libusb_exit(m_pContext);
+        m_pContext = nullptr;
+    }
+}
+
+vector<DeviceIdentity> DeviceMonitor::devices() const
+{
+    vector<DeviceIdentity> t_devices;
+
+    lock_guard<mutex> t_locker(m_mutex);
+    for (const auto &device : m_devices)
+        t_devices.push_back(device.second);
+
+    return t_devices;
+}
+
+bool DeviceMonitor::startStream(const string &serial, SampleRateIndex sr, pCallbackRx p, void *pUserData, bool autoResume)
+{
+    if (!p)
+        return false;
+
+    uint64_t t_id = 0;
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+
+        auto t_session = m_sessions.find(serial);
+        if ((t_session != m_sessions.end()) && (t_session->second.dev || t_session->second.opening))
+            return false;
+
+        Session &session = m_sessions[serial];
+        session.sampleRate = sr;
+        session.callback   = p;
+        session.pUserData  = pUserData;
+        session.autoResume = autoResume;
+        session.resumes    = 0;
+        session.id         = ++m_lastSessionId;
+        session.opening    = true;
+        t_id = session.id;
+    }
+
+    if (openSession(serial, t_id, 1))
+        return true;
+
+    // with autoResume the stream starts when the receiver is plugged in
+    lock_guard<mutex> t_locker(m_mutex);
+    if (!autoResume && findSession(serial, t_id))
+        m_sessions.erase(serial);
+
+    return false;
+}
+
+void DeviceMonitor::stopStream(const string &serial)
+{
+    Descriptor t_dev = nullptr;
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+
+        auto t_session = m_sessions.find(serial);
+        if (t_session == m_sessions.end())
+            return;
+
+        t_dev = t_session->second.dev;
+        m_sessions.erase(t_session);
+    }
+
+    closeDevice(t_dev);
+}
+
+bool DeviceMonitor::setFrequency(const string &serial, uint32_t value)
+{
+    lock_guard<mutex> t_locker(m_mutex);
+
+    auto t_session = m_sessions.find(serial);
+    if (t_session == m_sessions.end())
+        return false;
+
+    Session &session = t_session->second;
+    session.hasFrequency = true;
+    session.frequency    = value;
+
+    return session.dev && m_loader.setFrequency(session.dev, value);
+}
+
+bool DeviceMonitor::setPream(const string &serial, float value)
+{
+    lock_guard<mutex> t_locker(m_mutex);
+
+    auto t_session = m_sessions.find(serial);
+    if (t_session == m_sessions.end())
+        return false;
+
+    Session &session = t_session->second;
+    session.hasPreamp = true;
+    session.preamp    = value;
+
+    return session.dev && m_loader.setPream(session.dev, value);
+}
+
+Descriptor DeviceMonitor::descriptor(const string &serial) const
+{
+    lock_guard<mutex> t_locker(m_mutex);
+
+    auto t_session = m_sessions.find(serial);
+    return t_session == m_sessions.end() ? nullptr : t_session->second.dev;
+}
+
+uint32_t DeviceMonitor::resumes(const string &serial) const
+{
+    lock_guard<mutex> t_locker(m_mutex);
+
+    auto t_session = m_sessions.find(serial);
+    return t_session == m_sessions.end() ? 0 : t_session->second.resumes;
+}
+
+int LIBUSB_CALL DeviceMonitor::onHotplug(libusb_context *pContext, libusb_device *pDevice,
+                                         libusb_hotplug_event event, void *pUserData)
+{
+    (void)pContext;
+
+    // no blocking libusb calls are allowed here, the event is handled by eventLoop()
+    DeviceMonitor *pMonitor = static_cast<DeviceMonitor*>(pUserData);
+
+    Event t_event;
+    t_event.pDevice = libusb_ref_device(pDevice);
+    t_event.arrived = event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED;
+
+    lock_guard<mutex> t_locker(pMonitor->m_eventsMutex);
+    pMonitor->m_events.push_back(t_event);
+
+    return 0;
+}
+
+void DeviceMonitor::eventLoop()
+{
+    while (m_running) {
+        processEvents();
+
+        // hotplug callbacks are called from here, stop() interrupts the wait
+        libusb_handle_events_completed(m_pContext, nullptr);
+    }
+}
+
+void DeviceMonitor::processEvents()
+{
+    vector<Event> t_events;
+    {
+        lock_guard<mutex> t_locker(m_eventsMutex);
+        t_events.swap(m_events);
+    }
+
+    for (const Event &event : t_events) {
+        process(event);
+        libusb_unref_device(event.pDevice);
+    }
+}
+
+void DeviceMonitor::process(const Event &event)
+{
+    DeviceIdentity t_identity;
+
+    if (event.arrived) {
+        t_identity = identify(event.pDevice);
+        if (!isReceiver(t_identity))
+            return;
+
+        {
+            lock_guard<mutex> t_locker(m_mutex);
+            if (m_devices.count(event.pDevice))
+                return;
+
+            m_devices[libusb_ref_device(event.pDevice)] = t_identity;
+        }
+
+        if (m_callback)
+            m_callback(t_identity, true, m_pUserData);
+
+        uint64_t t_id = 0;
+        {
+            lock_guard<mutex> t_locker(m_mutex);
+            auto t_session = m_sessions.find(t_identity.serial);
+            if ((t_session != m_sessions.end()) && t_session->second.autoResume &&
+                !t_session->second.dev && !t_session->second.opening) {
+                t_session->second.opening = true;
+                t_id = t_session->second.id;
+            }
+        }
+
+        if (t_id && openSession(t_identity.serial, t_id, ResumeAttempts)) {
+            lock_guard<mutex> t_locker(m_mutex);
+            Session *pSession = findSession(t_identity.serial, t_id);
+            if (pSession)
+                ++pSession->resumes;
+        }
+    }
+    else {
+        Descriptor t_dev = nullptr;
+        {
+            lock_guard<mutex> t_locker(m_mutex);
+            auto t_device = m_devices.find(event.pDevice);
+            if (t_device == m_devices.end())
+                return;
+
+            t_identity = t_device->second;
+            libusb_unref_device(t_device->first);
+            m_devices.erase(t_device);
+
+            auto t_session = m_sessions.find(t_identity.serial);
+            if (t_session != m_sessions.end()) {
+                // the descriptor being opened is dropped by openSession()
+                if (t_session->second.opening)
+                    t_session->second.unplugged = true;
+
+                t_dev = t_session->second.dev;
+                t_session->second.dev = nullptr;
+                if (!t_session->second.autoResume && !t_session->second.opening)
+                    m_sessions.erase(t_session);
+            }
+        }
+
+        closeDevice(t_dev);
+
+        if (m_callback)
+            m_callback(t_identity, false, m_pUserData);
+    }
+}
+
+DeviceIdentity DeviceMonitor::identify(libusb_device *pDevice) const
+{
+    DeviceIdentity t_identity;
+    t_identity.bus     = libusb_get_bus_number(pDevice);
+    t_identity.address = libusb_get_device_address(pDevice);
+
+    libusb_device_descriptor t_desc;
+    libusb_device_handle *pHandle = nullptr;
+    if ((libusb_get_device_descriptor(pDevice, &t_desc) == 0) && (libusb_open(pDevice, &pHandle) == 0)) {
+        unsigned char t_str[128];
+        if (t_desc.iSerialNumber && (libusb_get_string_descriptor_ascii(pHandle, t_desc.iSerialNumber, t_str, sizeof(t_str)) > 0))
+            t_identity.serial = reinterpret_cast<char*>(t_str);
+        if (t_desc.iProduct && (libusb_get_string_descriptor_ascii(pHandle, t_desc.iProduct, t_str, sizeof(t_str)) > 0))
+            t_identity.description = reinterpret_cast<char*>(t_str);
+        libusb_close(pHandle);
+    }
+
+    // without access rights or EEPROM serial the USB location is the only identity
+    if (t_identity.serial.empty())
+        t_identity.serial = "usb:" + to_string(t_identity.bus) + "-" + to_string(t_identity.address);
+
+    return t_identity;
+}
+
+bool DeviceMonitor::isReceiver(const DeviceIdentity &identity)
+{
+    // the rule of the library scanner: product "ColibriNANO" in any case or serial "EED0..."
+    string t_product = identity.description;
+    for (char &c : t_product)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (t_product == ProductName)
+        return true;
+
+    string t_serial = identity.serial;
+    for (char &c : t_serial)
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+    return t_serial.compare(0, string(SerialPrefix).size(), SerialPrefix) == 0;
+}
+
+bool DeviceMonitor::connected(const string &serial) const
+{
+    for (const auto &device : m_devices) {
+        if (device.second.serial == serial)
+            return true;
+    }
+    return false;
+}
+
+DeviceMonitor::Session *DeviceMonitor::findSession(const string &serial, uint64_t id)
+{
+    auto t_session = m_sessions.find(serial);
+    if ((t_session == m_sessions.end()) || (t_session->second.id != id))
+        return nullptr;
+    return &t_session->second;
+}
+
+bool DeviceMonitor::openSession(const string &serial, uint64_t id, uint32_t attempts)
+{
+    bool t_opened = false;
+
+    for (uint32_t i = 0; (i < attempts) && !t_opened; ++i) {
+        if (i)
+            this_thread::sleep_for(ResumeRetryDelay);
+
+        // the library is called on a copy, the session may be stopped meanwhile
+        Session t_settings;
+        {
+            lock_guard<mutex> t_locker(m_mutex);
+            Session *pSession = findSession(serial, id);
+            if (!pSession || !connected(serial))
+                break;
+
+            pSession->unplugged = false;
+            t_settings = *pSession;
+        }
+
+        uint32_t t_index = 0;
+        Descriptor t_dev = nullptr;
+        if (!m_loader.deviceIndex(serial, t_index) || !m_loader.open(&t_dev, t_index) || (t_dev == nullptr))
+            continue;
+
+        if (t_settings.hasFrequency)
+            m_loader.setFrequency(t_dev, t_settings.frequency);
+        if (t_settings.hasPreamp)
+            m_loader.setPream(t_dev, t_settings.preamp);
+
+        if (!m_loader.start(t_dev, t_settings.sampleRate, t_settings.callback, t_settings.pUserData)) {
+            m_loader.close(t_dev);
+            continue;
+        }
+
+        bool t_stopped = false;
+        {
+            lock_guard<mutex> t_locker(m_mutex);
+            Session *pSession = findSession(serial, id);
+            if (pSession && !pSession->unplugged) {
+                pSession->dev = t_dev;
+                t_opened = true;
+
+                // values set while the receiver was being opened
+                if (pSession->hasFrequency && (!t_settings.hasFrequency || (pSession->frequency != t_settings.frequency)))
+                    m_loader.setFrequency(t_dev, pSession->frequency);
+                if (pSession->hasPreamp && (!t_settings.hasPreamp || (pSession->preamp != t_settings.preamp)))
+                    m_loader.setPream(t_dev, pSession->preamp);
+            }
+            else {
+                t_stopped = !pSession;
+            }
+        }
+
+        if (!t_opened) {
+            // stopped, or unplugged and maybe plugged in again, while opening
+            closeDevice(t_dev);
+            if (t_stopped)
+                break;
+        }
+    }
+
+    lock_guard<mutex> t_locker(m_mutex);
+    Session *pSession = findSession(serial, id);
+    if (pSession) {
+        pSession->opening = false;
+
+        // unplugged on the last attempt, the session of a plain stream ends here
+        if (!pSession->dev && pSession->unplugged && !pSession->autoResume)
+            m_sessions.erase(serial);
+    }
+
+    return t_opened;
+}
+
+void DeviceMonitor::closeDevice(Descriptor dev)
+{
+    if (!dev)
+        return;
+
+    m_loader.stop(dev);
+    m_loader.close(dev);
+}
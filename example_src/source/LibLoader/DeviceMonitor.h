@@ -0,0 +1,201 @@
+#ifndef DEVICEMONITOR_H
+#define DEVICEMONITOR_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libusb.h>
+
+#include "LibLoader.h"
+
+using namespace std;
+
+/**
+ * \brief Identity of a connected receiver.
+ *
+ * \details serial is the FTDI serial number written in the FT232H EEPROM, it does
+ * not change when the receiver is moved to another port. description is the USB
+ * product string, bus and address are the current USB location. The index for
+ * LibLoader::open() is not kept here, it is LibLoader::deviceIndex(serial).
+ */
+struct DeviceIdentity
+{
+    string   serial;
+    string   description;
+    uint8_t  bus     { 0 };
+    uint8_t  address { 0 };
+};
+
+/**
+ * \brief Hotplug monitor and auto-resume of ColibriNANO receivers (Linux, libusb).
+ *
+ * \details The monitor registers a libusb hotplug callback for the FT232H and keeps
+ * the list of connected receivers, so devices() does not rescan USB. Arrival and
+ * removal are reported by the callback set with setCallback(), called from the
+ * monitor thread.
+ * A stream started with startStream() is bound to the serial number of the receiver.
+ * When the receiver is unplugged its stream is stopped and the descriptor closed;
+ * with autoResume the monitor reopens the receiver as soon as it is plugged in
+ * again and restarts the stream with the last sample rate, frequency, preamplifier
+ * and callback. Events wake the monitor thread, nothing is polled. The library may
+ * need a few milliseconds after arrival to see the device, so the reopen is
+ * retried ResumeAttempts times.
+ * An FT232H is taken for a receiver by the rule of the library: the product string
+ * is ProductName in any case or the serial number starts with SerialPrefix. Other
+ * FT232H devices are not reported. The product and serial are read over libusb, so
+ * without access rights to the device it is not reported either, the library could
+ * not open it anyway.
+ * The index for LibLoader::open() is resolved by LibLoader::deviceIndex() from the
+ * serial number before every open, it changes with any FTDI device plugged in.
+ * The receiver is opened, started, stopped and closed without the monitor lock:
+ * devices(), setFrequency() and the hotplug events are not held up by a reopen and
+ * its retries. A descriptor is taken out of its session under the lock before it
+ * is stopped and closed. Only the short setFrequency()/setPream() commands are
+ * sent under the lock, so they never reach a descriptor being closed.
+ *
+ * \code
+ * DeviceMonitor t_monitor(m_loader);
+ * t_monitor.setCallback(MainWindow::deviceEvent, this);
+ * t_monitor.start();
+ * t_monitor.startStream(t_serial, Sr_1920kHz, DspCore::callbackRx, nullptr, true);
+ * \endcode
+ */
+class DeviceMonitor
+{
+public:
+    typedef void (*pDeviceEvent)(const DeviceIdentity &identity, bool arrived, void *pUserData);
+
+    static constexpr uint16_t VendorId  = 0x0403;
+    static constexpr uint16_t ProductId = 0x6014;     // FT232H
+
+    static constexpr const char *ProductName  = "colibrinano";
+    static constexpr const char *SerialPrefix = "EED0";
+
+    static constexpr uint32_t ResumeAttempts = 10;
+    static constexpr chrono::milliseconds ResumeRetryDelay { 20 };
+
+    explicit DeviceMonitor(LibLoader &loader);
+    ~DeviceMonitor();
+
+    /**
+     * \brief Set the arrival/removal callback, before start().
+     */
+    void setCallback(pDeviceEvent p, void *pUserData);
+
+    /**
+     * \brief Register the hotplug callback and start the monitor thread.
+     * \return false if libusb has no hotplug support on this system.
+     *
+     * \details Receivers connected before start() are reported as arrived from
+     * start() itself, before it returns: startStream() may follow it at once.
+     */
+    bool start();
+
+    /**
+     * \brief Stop all streams started by the monitor and the monitor thread.
+     */
+    void stop();
+
+    /**
+     * \brief Return connected receivers.
+     */
+    vector<DeviceIdentity> devices() const;
+
+    /**
+     * \brief Open the receiver by serial number and start IQ stream.
+     * \param autoResume - restart the stream when the receiver is plugged in again.
+     */
+    bool startStream(const string &serial, SampleRateIndex sr, pCallbackRx p, void *pUserData, bool autoResume);
+
+    /**
+     * \brief Stop the stream and close the receiver.
+     */
+    void stopStream(const string &serial);
+
+    /**
+     * \brief Set frequency and preamplifier, the values are kept for resume.
+     */
+    bool setFrequency(const string &serial, uint32_t value);
+    bool setPream(const string &serial, float value);
+
+    /**
+     * \brief Return descriptor of a running stream, nullptr if the receiver is unplugged.
+     */
+    Descriptor descriptor(const string &serial) const;
+
+    /**
+     * \brief Return amount of automatic restarts of the stream.
+     */
+    uint32_t resumes(const string &serial) const;
+
+private:
+    DeviceMonitor(const DeviceMonitor &) = delete;
+    DeviceMonitor &operator=(const DeviceMonitor &) = delete;
+
+    struct Event
+    {
+        libusb_device *pDevice { nullptr };     // referenced until processed
+        bool           arrived { false };
+    };
+
+    struct Session
+    {
+        SampleRateIndex sampleRate { Sr_48kHz };
+        pCallbackRx     callback   { nullptr };
+        void           *pUserData  { nullptr };
+        bool            autoResume { false };
+
+        bool     hasFrequency { false };
+        uint32_t frequency    { 0 };
+        bool     hasPreamp    { false };
+        float    preamp       { 0 };
+
+        Descriptor dev     { nullptr };
+        uint32_t   resumes { 0 };
+
+        uint64_t id        { 0 };       // startStream() that created the session
+        bool     opening   { false };   // openSession() in progress, without m_mutex
+        bool     unplugged { false };   // the receiver left while opening
+    };
+
+    static int LIBUSB_CALL onHotplug(libusb_context *pContext, libusb_device *pDevice,
+                                     libusb_hotplug_event event, void *pUserData);
+
+    void eventLoop();
+    void processEvents();
+    void process(const Event &event);
+    DeviceIdentity identify(libusb_device *pDevice) const;
+    static bool isReceiver(const DeviceIdentity &identity);
+    bool connected(const string &serial) const;
+    Session *findSession(const string &serial, uint64_t id);
+    bool openSession(const string &serial, uint64_t id, uint32_t attempts);
+    void closeDevice(Descriptor dev);
+
+private:
+    LibLoader &m_loader;
+
+    libusb_context                *m_pContext { nullptr };
+    libusb_hotplug_callback_handle m_hotplug  { 0 };
+    thread                         m_thread;
+    atomic_bool                    m_running  { false };
+
+    // filled by onHotplug, drained by the monitor thread
+    mutex         m_eventsMutex;
+    vector<Event> m_events;
+
+    pDeviceEvent m_callback  { nullptr };
+    void        *m_pUserData { nullptr };
+
+    mutable mutex                        m_mutex;
+    map<libusb_device*, DeviceIdentity>  m_devices;
+    map<string, Session>                 m_sessions;
+    uint64_t                             m_lastSessionId { 0 };
+};
+
+#endif // DEVICEMONITOR_H
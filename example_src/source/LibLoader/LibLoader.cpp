@@ -1,4 +1,7 @@
 #include "LibLoader.h"
+#include "unpack.h"
+
+constexpr uint32_t LibLoader::ConvertedSamples;
 
 #ifndef __linux__
 bool LibLoader::load(const wstring &file)
@@ -47,10 +50,16 @@ bool LibLoader::load(const char *file)
     if (m_start == nullptr)
         return false;
 
+    // optional, absent in library versions without native sample formats
+    m_startEx = reinterpret_cast<pStartEx>(GetProcAddress(hDLL, "start_ex"));
+
     m_stop = reinterpret_cast<pStop>(GetProcAddress(hDLL, "stop"));
     if (m_stop == nullptr)
         return false;
 
+    // optional, absent in library versions with fixed ring capacities
+    m_ringStatistics = reinterpret_cast<pRingStatistics>(GetProcAddress(hDLL, "ring_statistics"));
+
     m_setPreamp = reinterpret_cast<pSetPreamp>(GetProcAddress(hDLL, "setPream"));
     if (m_setPreamp == nullptr)
         return false;
@@ -59,6 +68,17 @@ bool LibLoader::load(const char *file)
     if (m_setFrequency == nullptr)
         return false;
 
+    // optional, the D2XX device list for deviceIndex()
+#ifndef __linux__
+    HMODULE hD2xx = GetModuleHandleW(L"ftd2xx.dll");
+#else
+    void *hD2xx = hDLL;
+#endif
+    if (hD2xx) {
+        m_createDeviceInfoList = reinterpret_cast<pCreateDeviceInfoList>(GetProcAddress(hD2xx, "FT_CreateDeviceInfoList"));
+        m_getDeviceInfoDetail  = reinterpret_cast<pGetDeviceInfoDetail>(GetProcAddress(hD2xx, "FT_GetDeviceInfoDetail"));
+    }
+
     return true;
 }
 
@@ -102,51 +122,598 @@ string LibLoader::information()
 
 uint32_t LibLoader::devices()
 {
+    lock_guard<shared_timed_mutex> t_control(m_controlMutex);
+
     uint32_t t_count = 0;
     if (m_devices)
         m_devices(t_count);
     return t_count;
 }
 
-bool LibLoader::open(Descriptor *pDev, const uint32_t devIndex)
+bool LibLoader::deviceIndex(const string &serial, uint32_t &index)
 {
-    if (m_open)
-        return m_open(pDev, devIndex);
+    lock_guard<shared_timed_mutex> t_control(m_controlMutex);
+
+    // FT_OK is 0
+    uint32_t t_count = 0;
+    if (!m_createDeviceInfoList || !m_getDeviceInfoDetail || (m_createDeviceInfoList(&t_count) != 0))
+        return false;
+
+    for (uint32_t i = 0; i < t_count; ++i) {
+        uint32_t t_flags = 0, t_type = 0, t_id = 0, t_location = 0;
+        char t_serial[16]      = { 0 };
+        char t_description[64] = { 0 };
+        void *pHandle = nullptr;
+        if (m_getDeviceInfoDetail(i, &t_flags, &t_type, &t_id, &t_location, t_serial, t_description, &pHandle) != 0)
+            continue;
+
+        t_serial[sizeof(t_serial) - 1] = 0;
+        if (serial == t_serial) {
+            index = i;
+            return true;
+        }
+    }
+
     return false;
 }
 
+bool LibLoader::open(Descriptor *pDev, const uint32_t devIndex)
+{
+    lock_guard<shared_timed_mutex> t_control(m_controlMutex);
+
+    if (!m_open || !m_open(pDev, devIndex))
+        return false;
+
+    if (*pDev)
+        m_deviceMutexes[*pDev].reset(new mutex);
+    return true;
+}
+
 void LibLoader::close(Descriptor dev)
 {
-    if (m_open)
-        m_close(dev);
+    {
+        lock_guard<shared_timed_mutex> t_control(m_controlMutex);
+        if (m_close)
+            m_close(dev);
+        m_deviceMutexes.erase(dev);
+    }
+
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    m_streams.erase(dev);
+    m_budgets.erase(dev);
+    m_tagLatencies.erase(dev);
+    for (auto &policies : m_policies)
+        policies.erase(dev);
 }
 
 bool LibLoader::start(Descriptor dev, SampleRateIndex sr, pCallbackRx p, void *pUserData)
 {
-    if (m_start)
-        return m_start(dev, sr, p, pUserData);
-    return false;
+    return start(dev, sr, p, nullptr, pUserData);
+}
+
+bool LibLoader::start(Descriptor dev, SampleRateIndex sr, pCallbackRxTagged p, void *pUserData)
+{
+    return start(dev, sr, nullptr, p, pUserData);
+}
+
+bool LibLoader::start(Descriptor dev, SampleRateIndex sr, pCallbackRx p, pCallbackRxTagged tagged, void *pUserData)
+{
+    if (!m_start || (!p && !tagged))
+        return false;
+
+    // the user callback is called through callbackRx() which measures it
+    unique_ptr<Stream> t_stream(new Stream);
+    t_stream->callback   = p;
+    t_stream->tagged     = tagged;
+    t_stream->pUserData  = pUserData;
+    t_stream->sampleRate = sampleRate(sr)*1e-9;
+    t_stream->tagBuffer  = ringSamples(TagBufferMs, sr);
+
+    Stream *pStream = t_stream.get();
+    if (!setup(dev, t_stream))
+        return false;
+
+    bool t_started = false;
+    {
+        DeviceLock t_control(*this, dev);
+        t_started = t_control.owns() && m_start(dev, sr, &LibLoader::callbackRx, pStream);
+    }
+    if (!t_started)
+        release(dev, pStream);
+
+    return t_started;
+}
+
+bool LibLoader::startEx(Descriptor dev, SampleRateIndex sr, StreamOptions &options, pCallbackRxEx p, void *pUserData)
+{
+    if (!m_start || !p || (options.format >= SampleFormatsCount))
+        return false;
+
+    options.size = sizeof(StreamOptions);
+
+    if (options.transferBits == 0)
+        options.transferBits = 16;
+    if ((options.transferBits != 24) && (options.transferBits != 16) && (options.transferBits != 8))
+        return false;
+
+    // the receiver sends 24-bit words only up to 384 kHz
+    if ((options.transferBits == 24) && (sr > Sr_384kHz))
+        return false;
+
+    if (options.transferSize && ((options.transferSize % 64) || (options.transferSize > 65536)))
+        return false;
+    if (options.transfers > 64)
+        return false;
+    if (options.latencyTimer && ((options.latencyTimer < 2) || (options.latencyTimer > 255)))
+        return false;
+    if (options.reserved)
+        return false;
+    for (uint32_t i = 0; i < RingsCount; ++i) {
+        if (options.ringMs[i] > MaxRingMs)
+            return false;
+    }
+
+    // byte and 24-bit modes are switched inside the library, the fallback path is always 16-bit
+    options.ignored = 0;
+    if (!m_startEx) {
+        if (options.transferBits != 16)
+            options.ignored |= So_TransferBits;
+        if (options.fused)
+            options.ignored |= So_Fused;
+        if (options.transferSize || options.transfers || options.latencyTimer)
+            options.ignored |= So_UsbTransfer;
+        for (uint32_t i = 0; i < RingsCount; ++i) {
+            if (options.ringMs[i])
+                options.ignored |= So_RingMs;
+        }
+
+        options.transferBits = 16;
+        options.fused        = 0;
+        options.transferSize = 0;
+        options.transfers    = 0;
+        options.latencyTimer = 0;
+        options.blockSize    = DefaultBlockSize;
+        for (uint32_t i = 0; i < RingsCount; ++i)
+            options.ringMs[i] = 0;
+    }
+
+    uint32_t t_formatBits = 24;     // float mantissa
+    switch (options.format) {
+        case Sf_Int32: t_formatBits = 32; break;
+        case Sf_Int16: t_formatBits = 16; break;
+        case Sf_Int8:  t_formatBits = 8; break;
+        default: break;
+    }
+    options.effectiveBits = options.transferBits < t_formatBits ? options.transferBits : t_formatBits;
+
+    unique_ptr<Stream> t_stream(new Stream);
+    t_stream->callbackEx = p;
+    t_stream->format     = static_cast<SampleFormat>(options.format);
+    t_stream->pUserData  = pUserData;
+    t_stream->sampleRate = sampleRate(sr)*1e-9;
+
+    if (!m_startEx) {
+        // sized once, longer blocks are converted and delivered in parts
+        t_stream->converted.resize(ConvertedSamples*2*sizeof(int32_t));
+        switch (options.format) {
+            case Sf_Int32: options.scale = 1.0f/8388607; break;
+            case Sf_Int16: options.scale = 1.0f/32767; break;
+            case Sf_Int8:  options.scale = 1.0f/127; break;
+            default:       options.scale = 1.0f; break;
+        }
+    }
+
+    Stream *pStream = t_stream.get();
+    if (!setup(dev, t_stream))
+        return false;
+
+    bool t_started = false;
+    {
+        DeviceLock t_control(*this, dev);
+        t_started = t_control.owns() &&
+                    (m_startEx ? m_startEx(dev, sr, &options, &LibLoader::callbackRxEx, pStream)
+                               : m_start(dev, sr, &LibLoader::callbackRx, pStream));
+    }
+    if (!t_started)
+        release(dev, pStream);
+
+    return t_started;
+}
+
+bool LibLoader::setup(Descriptor dev, unique_ptr<Stream> &stream)
+{
+    lock_guard<mutex> t_locker(m_streamsMutex);
+
+    // the library thread of a running stream still uses its Stream
+    auto t_current = m_streams.find(dev);
+    if ((t_current != m_streams.end()) && t_current->second->running)
+        return false;
+
+    auto t_budget = m_budgets.find(dev);
+    if (t_budget != m_budgets.end())
+        stream->budget = chrono::duration_cast<chrono::nanoseconds>(t_budget->second).count();
+
+    auto t_latency = m_tagLatencies.find(dev);
+    if (t_latency != m_tagLatencies.end())
+        stream->tagLatency = t_latency->second;
+
+    auto t_policy = m_policies[DspThread].find(dev);
+    if (t_policy != m_policies[DspThread].end()) {
+        stream->hasPolicy = true;
+        stream->policy    = t_policy->second;
+    }
+
+    stream->running = true;
+    m_streams[dev]  = move(stream);
+    return true;
+}
+
+void LibLoader::release(Descriptor dev, const Stream *pStream)
+{
+    lock_guard<mutex> t_locker(m_streamsMutex);
+
+    auto t_stream = m_streams.find(dev);
+    if ((t_stream != m_streams.end()) && (t_stream->second.get() == pStream))
+        m_streams.erase(t_stream);
+}
+
+LibLoader::DeviceLock::DeviceLock(LibLoader &loader, Descriptor dev) :
+  m_list(loader.m_controlMutex)
+{
+    auto t_mutex = loader.m_deviceMutexes.find(dev);
+    if (t_mutex != loader.m_deviceMutexes.end())
+        m_device = unique_lock<mutex>(*t_mutex->second);
+}
+
+void LibLoader::usbPreset(UsbPreset preset, StreamOptions &options) noexcept
+{
+    switch (preset) {
+        case Usb_LowLatency:
+            options.transferSize = 4096;
+            options.transfers    = 4;
+            options.latencyTimer = 2;
+            break;
+        case Usb_MaxThroughput:
+            options.transferSize = 65536;
+            options.transfers    = 16;
+            options.latencyTimer = 16;
+            break;
+        default:
+            options.transferSize = 0;
+            options.transfers    = 0;
+            options.latencyTimer = 0;
+            break;
+    }
+}
+
+bool LibLoader::hasNativeFormats() const noexcept
+{
+    return m_startEx != nullptr;
 }
 
 bool LibLoader::stop(Descriptor dev)
 {
-    if (m_stop)
-        return m_stop(dev);
-    return false;
+    {
+        DeviceLock t_control(*this, dev);
+        if (!t_control.owns() || !m_stop || !m_stop(dev))
+            return false;
+    }
+
+    // statistics stay readable until the next start()
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    auto t_stream = m_streams.find(dev);
+    if (t_stream != m_streams.end())
+        t_stream->second->running = false;
+
+    return true;
 }
 
 bool LibLoader::setPream(Descriptor dev, float value)
 {
-    if (m_setPreamp)
-        return m_setPreamp(dev, value);
-    return false;
+    // ring_statistics is called for the tag under the same lock as the command
+    DeviceLock t_control(*this, dev);
+    if (!t_control.owns() || !m_setPreamp || !m_setPreamp(dev, value))
+        return false;
+
+    addTag(dev, StreamTag::Preamp, value);
+    return true;
 }
 
 bool LibLoader::setFrequency(Descriptor dev, uint32_t value)
 {
-    if (m_setFrequency)
-        return m_setFrequency(dev, value);
-    return false;
+    // ring_statistics is called for the tag under the same lock as the command
+    DeviceLock t_control(*this, dev);
+    if (!t_control.owns() || !m_setFrequency || !m_setFrequency(dev, value))
+        return false;
+
+    addTag(dev, StreamTag::Frequency, value);
+    return true;
+}
+
+void LibLoader::setCallbackBudget(Descriptor dev, chrono::microseconds budget)
+{
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    m_budgets[dev] = budget;
+}
+
+void LibLoader::setTagLatency(Descriptor dev, uint32_t latency)
+{
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    m_tagLatencies[dev] = latency;
+}
+
+void LibLoader::setThreadPolicy(Descriptor dev, LibraryThread thread, const ThreadPolicy &policy)
+{
+    if (thread >= LibraryThreadsCount)
+        return;
+
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    m_policies[thread][dev] = policy;
+}
+
+ThreadPolicyResult LibLoader::threadPolicyResult(Descriptor dev, LibraryThread thread)
+{
+    ThreadPolicyResult t_result;
+    if (thread != DspThread)
+        return t_result;
+
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    auto t_stream = m_streams.find(dev);
+    if ((t_stream != m_streams.end()) && t_stream->second->policyApplied.load(memory_order_acquire))
+        t_result = t_stream->second->policyResult;
+
+    return t_result;
+}
+
+CallbackStatistics LibLoader::callbackStatistics(Descriptor dev)
+{
+    CallbackStatistics t_stat;
+
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    auto t_stream = m_streams.find(dev);
+    if (t_stream == m_streams.end())
+        return t_stat;
+
+    const Stream &stream = *t_stream->second;
+    t_stat.calls        = stream.calls;
+    t_stat.rejected     = stream.rejected;
+    t_stat.overBudget   = stream.overBudget;
+    t_stat.lastDuration = stream.lastDuration;
+    t_stat.maxDuration  = stream.maxDuration;
+    t_stat.maxGap       = stream.maxGap;
+    t_stat.samples      = stream.samples;
+    t_stat.samplesLost  = stream.samplesLost;
+    t_stat.tagsDropped  = stream.tagsDropped;
+
+    return t_stat;
+}
+
+bool LibLoader::ringStatistics(Descriptor dev, RingIndex ring, RingStatistics &stat)
+{
+    stat.capacity  = 0;
+    stat.highWater = 0;
+    stat.overflows = 0;
+    stat.fill      = 0;
+
+    if (!m_ringStatistics || (ring >= RingsCount))
+        return false;
+
+    return m_ringStatistics(dev, ring, &stat);
+}
+
+uint32_t LibLoader::ringSamples(uint32_t ms, SampleRateIndex sr) noexcept
+{
+    return static_cast<uint32_t>(static_cast<uint64_t>(sampleRate(sr))*ms/1000);
+}
+
+uint32_t LibLoader::sampleRate(SampleRateIndex sr) noexcept
+{
+    switch (sr) {
+        case Sr_48kHz: return 48000;
+        case Sr_96kHz: return 96000;
+        case Sr_192kHz: return 192000;
+        case Sr_384kHz: return 384000;
+        case Sr_768kHz: return 768000;
+        case Sr_1536kHz: return 1536000;
+        case Sr_1920kHz: return 1920000;
+        case Sr_2560kHz: return 2560000;
+        case Sr_3072kHz: return 3072000;
+
+        default: break;
+    }
+
+    return 48000;
+}
+
+void LibLoader::addTag(Descriptor dev, StreamTag::Type type, double value)
+{
+    lock_guard<mutex> t_locker(m_streamsMutex);
+    auto t_stream = m_streams.find(dev);
+    if ((t_stream == m_streams.end()) || !t_stream->second->tagged)
+        return;
+
+    Stream &stream = *t_stream->second;
+    const uint32_t t_head = stream.tagsHead.load(memory_order_relaxed);
+    if (t_head - stream.tagsTail.load(memory_order_acquire) >= TagsQueueSize) {
+        stream.tagsDropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    // samples of the block being delivered and the ones still in the library
+    // rings were taken before the command
+    uint64_t t_buffered = 0;
+    RingStatistics t_ring;
+    for (uint32_t i = 0; i < RingsCount; ++i) {
+        if (!m_ringStatistics || !m_ringStatistics(dev, static_cast<RingIndex>(i), &t_ring)) {
+            t_buffered = stream.tagBuffer;
+            break;
+        }
+        t_buffered += t_ring.fill;
+    }
+
+    StreamTag &tag = stream.tags[t_head & (TagsQueueSize - 1)];
+    tag.type   = type;
+    tag.offset = 0;
+    tag.sample = stream.position.load(memory_order_acquire) + t_buffered + stream.tagLatency;
+    tag.value  = value;
+
+    stream.tagsHead.store(t_head + 1, memory_order_release);
+}
+
+uint32_t LibLoader::takeTags(Stream &stream, uint64_t begin, uint32_t len, StreamTag *pTags)
+{
+    uint32_t t_tail = stream.tagsTail.load(memory_order_relaxed);
+    const uint32_t t_head = stream.tagsHead.load(memory_order_acquire);
+
+    uint32_t t_count = 0;
+    while ((t_tail != t_head) && (t_count < TagsPerBlock)) {
+        const StreamTag &tag = stream.tags[t_tail & (TagsQueueSize - 1)];
+        if (tag.sample >= begin + len)
+            break;
+
+        pTags[t_count] = tag;
+        pTags[t_count].offset = tag.sample > begin ? static_cast<uint32_t>(tag.sample - begin) : 0;
+        ++t_count;
+        ++t_tail;
+    }
+
+    stream.tagsTail.store(t_tail, memory_order_release);
+    return t_count;
+}
+
+bool LibLoader::callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData)
+{
+    Stream &stream = *static_cast<Stream*>(pUserData);
+
+    const uint64_t t_position = stream.position.fetch_add(len, memory_order_acq_rel);
+
+    const Clock::time_point t_begin = Clock::now();
+    bool t_result = false;
+    if (stream.callbackEx) {
+        // converted samples are delivered in parts of the preallocated buffer
+        const uint32_t t_part = stream.format == Sf_Float32 ? len : ConvertedSamples;
+        t_result = true;
+        for (uint32_t t_done = 0; t_done < len; t_done += t_part) {
+            const uint32_t t_len = len - t_done < t_part ? len - t_done : t_part;
+            t_result = stream.callbackEx(convert(stream, pSrc + t_done, t_len), t_len, adcOverload, stream.pUserData) && t_result;
+        }
+    }
+    else if (stream.tagged) {
+        StreamTag t_tags[TagsPerBlock];
+        const uint32_t t_count = takeTags(stream, t_position, len, t_tags);
+        t_result = stream.tagged(pSrc, len, adcOverload, t_tags, t_count, stream.pUserData);
+    }
+    else {
+        t_result = stream.callback(pSrc, len, adcOverload, stream.pUserData);
+    }
+
+    account(stream, len, t_begin, t_result);
+    return t_result;
+}
+
+bool LibLoader::callbackRxEx(const void *pSrc, uint32_t len, bool adcOverload, void *pUserData)
+{
+    Stream &stream = *static_cast<Stream*>(pUserData);
+
+    stream.position.fetch_add(len, memory_order_acq_rel);
+
+    const Clock::time_point t_begin = Clock::now();
+    const bool t_result = stream.callbackEx(pSrc, len, adcOverload, stream.pUserData);
+
+    account(stream, len, t_begin, t_result);
+    return t_result;
+}
+
+const void *LibLoader::convert(Stream &stream, const Complex *pSrc, uint32_t len)
+{
+    if (stream.format == Sf_Float32)
+        return pSrc;
+
+    const float *pIn = reinterpret_cast<const float*>(pSrc);
+    switch (stream.format) {
+        case Sf_Int32:
+            Unpack::pack(pIn, reinterpret_cast<int32_t*>(stream.converted.data()), 2*len, 8388607.0f);
+            break;
+        case Sf_Int16:
+            Unpack::pack(pIn, reinterpret_cast<int16_t*>(stream.converted.data()), 2*len, 32767.0f);
+            break;
+        default:
+            Unpack::pack(pIn, stream.converted.data(), 2*len, 127.0f);
+            break;
+    }
+
+    return stream.converted.data();
+}
+
+void LibLoader::account(Stream &stream, uint32_t len, Clock::time_point begin, bool result)
+{
+    const Clock::time_point t_end = Clock::now();
+
+    const uint64_t t_duration = chrono::duration_cast<chrono::nanoseconds>(t_end - begin).count();
+    const uint64_t t_budget   = stream.budget ? stream.budget : static_cast<uint64_t>(len/stream.sampleRate);
+
+    stream.lastDuration.store(t_duration, memory_order_relaxed);
+    if (t_duration > stream.maxDuration.load(memory_order_relaxed))
+        stream.maxDuration.store(t_duration, memory_order_relaxed);
+    if (t_duration > t_budget)
+        stream.overBudget.fetch_add(1, memory_order_relaxed);
+    if (!result)
+        stream.rejected.fetch_add(1, memory_order_relaxed);
+
+    if (stream.calls.fetch_add(1, memory_order_relaxed) == 0) {
+        stream.windowBegin = begin;
+
+        // the first invocation runs on the library thread the policy is meant for
+        if (stream.hasPolicy) {
+            stream.policyResult = applyThreadPolicy(stream.policy);
+            stream.policyApplied.store(true, memory_order_release);
+        }
+    }
+    else {
+        const uint64_t t_gap = chrono::duration_cast<chrono::nanoseconds>(begin - stream.lastCall).count();
+        if (t_gap > stream.maxGap.load(memory_order_relaxed))
+            stream.maxGap.store(t_gap, memory_order_relaxed);
+        stream.windowSamples += len;
+    }
+
+    stream.lastCall = begin;
+    stream.samples.fetch_add(len, memory_order_relaxed);
+    updateLost(stream, begin);
+}
+
+void LibLoader::updateLost(Stream &stream, Clock::time_point now)
+{
+    // samples delivered are compared against the nominal rate once per window
+    static constexpr auto Window    = chrono::seconds(1);
+    static constexpr auto Tolerance = chrono::milliseconds(50);
+
+    if (now - stream.windowBegin < Window)
+        return;
+
+    const double t_tolerance = stream.sampleRate*chrono::duration_cast<chrono::nanoseconds>(Tolerance).count();
+    const double t_expected  = stream.sampleRate*chrono::duration_cast<chrono::nanoseconds>(now - stream.windowBegin).count();
+
+    stream.deficit += t_expected - stream.windowSamples;
+    stream.windowBegin   = now;
+    stream.windowSamples = 0;
+
+    // a deficit is counted as lost only if the next window did not make it up;
+    // anything within the tolerance is dropped every window, so the slow
+    // difference between the ADC and host clocks does not accumulate
+    if (stream.deficit > t_tolerance) {
+        if (stream.deficitPending) {
+            stream.samplesLost.fetch_add(static_cast<uint64_t>(stream.deficit - t_tolerance), memory_order_relaxed);
+            stream.deficit        = 0;
+            stream.deficitPending = false;
+        }
+        else {
+            stream.deficitPending = true;
+        }
+    }
+    else {
+        stream.deficit        = 0;
+        stream.deficitPending = false;
+    }
 }
 
 
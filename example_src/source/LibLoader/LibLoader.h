@@ -7,10 +7,18 @@
 #  include <dlfcn.h>
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "common.h"
+#include "ThreadPolicy.h"
 
 #ifndef __linux__
 #  define COLIBRI_NANO_API __stdcall
@@ -42,6 +50,82 @@ using namespace std;
  *   Some PC won't be able to support highest sample rates values, it depends on the USB port quality.
  */
 
+/**
+ * \brief Statistics of the IQ callback path of one receiver.
+ *
+ * \details Durations are in nanoseconds. The library ignores the callback result and
+ * drops samples in its internal ring when the callback is slower than the stream,
+ * samplesLost is an estimate of those drops made from the delivered sample count
+ * against the nominal sample rate.
+ */
+struct CallbackStatistics
+{
+    uint64_t calls        { 0 };   ///< callback invocations
+    uint64_t rejected     { 0 };   ///< invocations returned false
+    uint64_t overBudget   { 0 };   ///< invocations longer than the budget
+    uint64_t lastDuration { 0 };   ///< duration of the last invocation
+    uint64_t maxDuration  { 0 };   ///< longest invocation
+    uint64_t maxGap       { 0 };   ///< longest interval between two invocations
+    uint64_t samples      { 0 };   ///< samples delivered to the callback
+    uint64_t samplesLost  { 0 };   ///< samples estimated as discarded upstream
+    uint64_t tagsDropped  { 0 };   ///< stream tags not queued, the tag queue was full
+};
+
+/**
+ * \brief Stream metadata attached to the IQ block.
+ *
+ * \details sample is the absolute number of the first sample that may be taken
+ * with the new parameter value, counted from start(). The library does not report
+ * when the receiver applied the command, sample is a lower bound: the first sample
+ * not yet delivered when setFrequency()/setPream() returned, plus the samples held
+ * by the library rings (their fill from ring_statistics, TagBufferMs of stream
+ * without it), plus the latency set by setTagLatency(). Samples before it were taken
+ * with the old value, a few samples after it may still be. offset is the index of
+ * that sample in the current block, 0 if the sample belongs to one of the previous
+ * blocks. Tags that do not fit the queue are dropped and counted in
+ * CallbackStatistics::tagsDropped.
+ */
+struct StreamTag
+{
+    enum Type : uint32_t
+    {
+        Frequency = 0,   ///< value - tuning frequency, Hz
+        Preamp           ///< value - gain/attenuation, dB
+    };
+
+    Type     type   { Frequency };
+    uint32_t offset { 0 };
+    uint64_t sample { 0 };
+    double   value  { 0 };
+};
+
+typedef bool (*pCallbackRxTagged)(Complex *pSrc, uint32_t len, bool adcOverload,
+                                  const StreamTag *pTags, uint32_t tags, void *pUserData);
+
+/**
+ * \brief Internal threads of the library, one set per receiver.
+ */
+enum LibraryThread
+{
+    DriverThread = 0,   ///< USB reads
+    ParserThread,       ///< frame parsing
+    DspThread,          ///< calls pCallbackRx
+    LibraryThreadsCount
+};
+
+/**
+ * \brief Loader of the ColibriNANO library.
+ *
+ * \details Every library call looks its descriptor up in one global list of the
+ * library, which has no lock: open and close insert and remove list entries,
+ * the other calls only read the list and then work on the objects of their own
+ * descriptor, which the library does not lock either. So devices, deviceIndex,
+ * open and close hold the list lock exclusively, while start, stop, setPream and
+ * setFrequency hold it shared plus the lock of their descriptor: calls for
+ * different receivers run in parallel, calls for one receiver one after another.
+ * The methods may be called from any thread, but not from the IQ callback,
+ * because stop() may wait for the callback to return.
+ */
 class LibLoader
 {
     typedef void (COLIBRI_NANO_API *pVersion)(uint32_t&, uint32_t&, uint32_t&);
@@ -51,11 +135,20 @@ class LibLoader
     typedef bool (COLIBRI_NANO_API *pOpen)(Descriptor*, const uint32_t);
     typedef void (COLIBRI_NANO_API *pClose)(Descriptor);
     typedef bool (COLIBRI_NANO_API *pStart)(Descriptor, SampleRateIndex, pCallbackRx, void*);
+    typedef bool (COLIBRI_NANO_API *pStartEx)(Descriptor, SampleRateIndex, StreamOptions*, pCallbackRxEx, void*);
     typedef bool (COLIBRI_NANO_API *pStop)(Descriptor);
+    typedef bool (COLIBRI_NANO_API *pRingStatistics)(Descriptor, RingIndex, RingStatistics*);
     typedef bool (COLIBRI_NANO_API *pSetPreamp)(Descriptor, float);
     typedef bool (COLIBRI_NANO_API *pSetFrequency)(Descriptor, uint32_t);
+    typedef uint32_t (COLIBRI_NANO_API *pCreateDeviceInfoList)(uint32_t*);
+    typedef uint32_t (COLIBRI_NANO_API *pGetDeviceInfoDetail)(uint32_t, uint32_t*, uint32_t*, uint32_t*, uint32_t*,
+                                                              char*, char*, void**);
 
 public:
+    static constexpr uint32_t DefaultBlockSize = 512;   ///< complex samples per callback of start()
+    static constexpr uint32_t MaxRingMs        = 10000; ///< largest StreamOptions::ringMs value
+    static constexpr uint32_t TagBufferMs      = 1;     ///< samples held by the library rings without ring_statistics, ms of stream
+
     LibLoader() = default;
 
     /**
@@ -101,6 +194,18 @@ public:
      */
     uint32_t devices();
 
+    /**
+     * \brief Find the index for open() of the receiver with the given FTDI serial number.
+     * \return false if the receiver is not found or the D2XX device list is not available.
+     *
+     * \details open() passes its index to D2XX FT_Open, which counts every FTDI device
+     * in the D2XX device list, not only receivers. The index is looked up in the same
+     * list through FT_CreateDeviceInfoList/FT_GetDeviceInfoDetail of the D2XX copy the
+     * library uses: exported by the library on Linux, ftd2xx.dll on Windows. The list
+     * changes when any FTDI device is plugged or unplugged, so resolve the index right
+     * before open().
+     */
+    bool deviceIndex(const string &serial, uint32_t &index);
 
     /**
      * \brief Open the ColibriNANO receiver according to its periodic number.
@@ -122,9 +227,85 @@ public:
      * \brief Start IQ stream.
      * \param dev - Receiver's descriptor.
      * \return if success return true, else false.
+     *
+     * \details Fails while the stream of dev is running, call stop() first.
      */
     bool start(Descriptor dev, SampleRateIndex sr, pCallbackRx p, void *pUserData);
 
+    /**
+     * \brief Start IQ stream with tagged callback.
+     * \param dev - Receiver's descriptor.
+     * \return if success return true, else false.
+     *
+     * \details Every block is delivered with the tags that took effect in it, see StreamTag.
+     */
+    bool start(Descriptor dev, SampleRateIndex sr, pCallbackRxTagged p, void *pUserData);
+
+    /**
+     * \brief Start IQ stream in the selected sample format.
+     * \param dev - Receiver's descriptor.
+     * \param options - format of samples, scale is set on success.
+     * \return if success return true, else false.
+     *
+     * \details Integer formats interleave re/im, len is amount of complex samples.
+     * Multiplying an integer sample by options.scale gives the value pCallbackRx would
+     * receive. If the library has no start_ex entry point, the stream is started by
+     * start() and converted here: the integer range is then the full float range
+     * -1..1, values outside it are saturated. This fallback does not save the float
+     * conversion of the library, it adds one more pass over every block.
+     *
+     * options.transferBits = 8 selects byte mode of the receiver: the ADC words are
+     * sent over USB truncated to 8 bits, halving the USB bandwidth so that 2560 and
+     * 3072 kHz can be received on weak USB ports. Dynamic range drops to about 48 dB
+     * (6 dB per bit) against about 96 dB of the 16-bit mode. Byte mode requires the
+     * start_ex entry point, without it the stream runs in 16-bit mode and
+     * options.transferBits is set to 16. options.effectiveBits reports resolution of
+     * the delivered samples: the smaller of the transfer width and the sample format.
+     *
+     * options.transferBits = 24 selects 24-bit words for sample rates up to 384 kHz,
+     * about 144 dB of dynamic range for weak-signal reception. The samples are
+     * delivered as Sf_Int32 in the 24-bit range or as Sf_Float32, where the float
+     * mantissa keeps all 24 bits. Like byte mode it requires start_ex.
+     *
+     * options.fused = 1 asks the library to call the callback directly from its
+     * parsing thread, keeping only the ring between USB reads and parsing. One thread
+     * hop and one ring copy less per block, useful on 2-core hosts; the callback time
+     * then delays parsing and must stay within the block duration. Without start_ex
+     * the option is ignored and reset to 0.
+     *
+     * options.transferSize, transfers and latencyTimer set size of one USB read
+     * (FT_SetUSBParameters and the parser read size), amount of reads in flight and
+     * the FTDI latency timer; usbPreset() fills them for typical uses. Smaller
+     * transfers and a short timer give smaller callback blocks and lower latency,
+     * larger transfers and a deeper queue survive longer USB stalls. Values outside
+     * the ranges in StreamOptions make startEx() fail. options.blockSize reports the
+     * callback block size. Without start_ex the library defaults are used, the
+     * parameters are reset to 0 and blockSize is set to DefaultBlockSize.
+     *
+     * options.ignored reports the requested options that had no effect as a mask of
+     * StreamOptionFlag: without start_ex every option above other than the default
+     * is listed there, a library with start_ex may list the ones it does not
+     * support. Check it instead of tuning values the library does not use.
+     *
+     * options.ringMs sets capacity of each internal ring (RingIndex) in milliseconds
+     * of stream at the chosen rate, up to MaxRingMs; 0 keeps the library default. A
+     * ring must cover the longest stall of its reader, e.g. a disk flush or a GC pause
+     * in the callback for Ring_Dsp. ringStatistics() reports the high-water marks to
+     * size them from measurements. Without start_ex the values are reset to 0 and
+     * So_RingMs is set in options.ignored.
+     */
+    bool startEx(Descriptor dev, SampleRateIndex sr, StreamOptions &options, pCallbackRxEx p, void *pUserData);
+
+    /**
+     * \brief Fill USB transfer parameters of options for the preset.
+     */
+    static void usbPreset(UsbPreset preset, StreamOptions &options) noexcept;
+
+    /**
+     * \brief Return true if the library converts samples itself in startEx().
+     */
+    bool hasNativeFormats() const noexcept;
+
     /**
      * \brief Stop IQ stream.
      * \param dev - Receiver's descriptor.
@@ -152,6 +333,158 @@ public:
      */
     bool setFrequency(Descriptor dev, uint32_t value);
 
+    /**
+     * \brief Set the time budget of one callback invocation.
+     * \param dev - Receiver's descriptor.
+     * \param budget - budget, 0 means the duration of the delivered block at the stream rate.
+     *
+     * \details Takes effect from the next start().
+     */
+    void setCallbackBudget(Descriptor dev, chrono::microseconds budget);
+
+    /**
+     * \brief Set the delay between command completion and the tagged sample.
+     * \param dev - Receiver's descriptor.
+     * \param latency - delay in samples of the receiver, added to the fill of the library rings.
+     *
+     * \details Takes effect from the next start().
+     */
+    void setTagLatency(Descriptor dev, uint32_t latency);
+
+    /**
+     * \brief Set affinity, scheduling and name of an internal thread of the receiver.
+     * \param dev - Receiver's descriptor.
+     * \param thread - library thread.
+     * \param policy - settings, see ThreadPolicy.
+     *
+     * \details Takes effect from the next start(). DspThread is the thread calling
+     * the callback (the parsing thread in fused mode), the policy is applied to it
+     * from its first callback invocation. DriverThread and ParserThread are not
+     * reachable through the library API, their policy is kept and reported as not
+     * applied.
+     */
+    void setThreadPolicy(Descriptor dev, LibraryThread thread, const ThreadPolicy &policy);
+
+    /**
+     * \brief Return settings of the thread policy that took effect.
+     * \param dev - Receiver's descriptor.
+     * \param thread - library thread.
+     */
+    ThreadPolicyResult threadPolicyResult(Descriptor dev, LibraryThread thread);
+
+    /**
+     * \brief Return statistics of the callback path since the last start().
+     * \param dev - Receiver's descriptor.
+     */
+    CallbackStatistics callbackStatistics(Descriptor dev);
+
+    /**
+     * \brief Return capacity and high-water mark of an internal ring since the last start().
+     * \param dev - Receiver's descriptor.
+     * \param ring - ring of the receiver.
+     * \param stat - statistics, zeroed on failure.
+     * \return false if the library does not report its rings (no ring_statistics entry point).
+     *
+     * \details The shipped library has no ring_statistics entry point: the call
+     * returns false with zeroed statistics, there is nothing to size from.
+     */
+    bool ringStatistics(Descriptor dev, RingIndex ring, RingStatistics &stat);
+
+    /**
+     * \brief Return amount of complex samples in ms of stream at the sample rate.
+     */
+    static uint32_t ringSamples(uint32_t ms, SampleRateIndex sr) noexcept;
+
+    /**
+     * \brief Return sample rate in Hz for the sample rate index.
+     */
+    static uint32_t sampleRate(SampleRateIndex sr) noexcept;
+
+private:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * \brief State of a running stream, passed to the library as pUserData.
+     */
+    static constexpr uint32_t TagsQueueSize = 64;       // power of two
+    static constexpr uint32_t TagsPerBlock  = 16;
+    static constexpr uint32_t ConvertedSamples = 16384;  // conversion buffer of startEx() without start_ex
+
+    struct Stream
+    {
+        pCallbackRx callback   { nullptr };
+        pCallbackRxTagged tagged { nullptr };
+        pCallbackRxEx callbackEx { nullptr };
+        SampleFormat format      { Sf_Float32 };
+        void       *pUserData  { nullptr };
+        double      sampleRate { 0 };          // samples per ns
+        uint64_t    budget     { 0 };          // ns, 0 - block duration
+
+        atomic<uint64_t> calls        { 0 };
+        atomic<uint64_t> rejected     { 0 };
+        atomic<uint64_t> overBudget   { 0 };
+        atomic<uint64_t> lastDuration { 0 };
+        atomic<uint64_t> maxDuration  { 0 };
+        atomic<uint64_t> maxGap       { 0 };
+        atomic<uint64_t> samples      { 0 };
+        atomic<uint64_t> samplesLost  { 0 };
+
+        // single producer under m_streamsMutex, single consumer in the Dsp thread
+        uint64_t          tagLatency { 0 };
+        uint64_t          tagBuffer  { 0 };        // samples held by the library rings without ring_statistics
+        atomic<uint64_t>  tagsDropped { 0 };
+        atomic<uint64_t>  position   { 0 };        // samples handed to the callback, including the current block
+        StreamTag         tags[TagsQueueSize];
+        atomic<uint32_t>  tagsHead   { 0 };
+        atomic<uint32_t>  tagsTail   { 0 };
+
+        // samples converted for startEx() without native support, sized in startEx()
+        vector<int8_t>    converted;
+
+        // set by setup(), cleared by stop(); guarded by m_streamsMutex
+        bool              running { false };
+
+        // applied from the first callback, the result is published by policyApplied
+        bool               hasPolicy { false };
+        ThreadPolicy       policy;
+        ThreadPolicyResult policyResult;
+        atomic_bool        policyApplied { false };
+
+        // accessed only from the library's Dsp thread
+        Clock::time_point lastCall;
+        Clock::time_point windowBegin;
+        uint64_t          windowSamples  { 0 };
+        double            deficit        { 0 };
+        bool              deficitPending { false };
+    };
+
+    bool start(Descriptor dev, SampleRateIndex sr, pCallbackRx p, pCallbackRxTagged tagged, void *pUserData);
+    bool setup(Descriptor dev, unique_ptr<Stream> &stream);
+    void release(Descriptor dev, const Stream *pStream);
+
+    // shared lock of the library descriptor list and the lock of one descriptor,
+    // owns() is false for a descriptor not opened by open()
+    class DeviceLock
+    {
+    public:
+        DeviceLock(LibLoader &loader, Descriptor dev);
+        bool owns() const noexcept { return m_device.owns_lock(); }
+
+    private:
+        shared_lock<shared_timed_mutex> m_list;
+        unique_lock<mutex>              m_device;
+    };
+
+    // called under DeviceLock of dev, queries ring_statistics for the fill of the rings
+    void addTag(Descriptor dev, StreamTag::Type type, double value);
+
+    static bool callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData);
+    static bool callbackRxEx(const void *pSrc, uint32_t len, bool adcOverload, void *pUserData);
+    static const void *convert(Stream &stream, const Complex *pSrc, uint32_t len);
+    static void account(Stream &stream, uint32_t len, Clock::time_point begin, bool result);
+    static uint32_t takeTags(Stream &stream, uint64_t begin, uint32_t len, StreamTag *pTags);
+    static void updateLost(Stream &stream, Clock::time_point now);
+
 private:
 #ifndef __linux__
     HMODULE hDLL                              { nullptr };
@@ -166,9 +499,24 @@ private:
     pOpen  m_open                             { nullptr };
     pClose m_close                            { nullptr };
     pStart m_start                            { nullptr };
+    pStartEx m_startEx                        { nullptr };
     pStop  m_stop                             { nullptr };
+    pRingStatistics m_ringStatistics          { nullptr };
     pSetPreamp m_setPreamp                    { nullptr };
     pSetFrequency m_setFrequency              { nullptr };
+    pCreateDeviceInfoList m_createDeviceInfoList { nullptr };
+    pGetDeviceInfoDetail  m_getDeviceInfoDetail  { nullptr };
+
+    // exclusive: devices/deviceIndex/open/close, shared: start/stop/setPream/setFrequency;
+    // m_deviceMutexes changes only under the exclusive lock
+    shared_timed_mutex                  m_controlMutex;
+    map<Descriptor, unique_ptr<mutex>>  m_deviceMutexes;
+
+    mutex m_streamsMutex;
+    map<Descriptor, unique_ptr<Stream>>      m_streams;
+    map<Descriptor, chrono::microseconds>    m_budgets;
+    map<Descriptor, uint32_t>                m_tagLatencies;
+    map<Descriptor, ThreadPolicy>            m_policies[LibraryThreadsCount];
 };
 
 #endif // LIBLOADER_H
@@ -0,0 +1,211 @@
+#include <thread>
+
+#include "SessionManager.h"
+
+SessionManager::SessionManager(LibLoader &loader) :
+  m_loader(loader)
+{
+
+}
+
+SessionManager::~SessionManager()
+{
+    close();
+}
+
+uint32_t SessionManager::open()
+{
+    close();
+
+    const uint32_t t_devices = m_loader.devices();
+    for (uint32_t i = 0; i < t_devices; ++i) {
+        unique_ptr<Receiver> t_receiver(new Receiver);
+        t_receiver->pSession = this;
+        t_receiver->device   = i;
+
+        if (!m_loader.open(&t_receiver->dev, i) || (t_receiver->dev == nullptr))
+            continue;
+
+        m_receivers.push_back(move(t_receiver));
+    }
+
+    return count();
+}
+
+void SessionManager::close()
+{
+    if (m_receivers.empty())
+        return;
+
+    forEach([this](Receiver &receiver) {
+        if (receiver.running)
+            m_loader.stop(receiver.dev);
+        receiver.running = false;
+    });
+
+    // close changes the descriptor list of the library, LibLoader runs it exclusively
+    for (const auto &receiver : m_receivers)
+        m_loader.close(receiver->dev);
+
+    m_receivers.clear();
+    m_running = false;
+}
+
+uint32_t SessionManager::count() const noexcept
+{
+    return static_cast<uint32_t>(m_receivers.size());
+}
+
+uint32_t SessionManager::device(uint32_t index) const noexcept
+{
+    return index < m_receivers.size() ? m_receivers[index]->device : 0;
+}
+
+Descriptor SessionManager::descriptor(uint32_t index) const noexcept
+{
+    return index < m_receivers.size() ? m_receivers[index]->dev : nullptr;
+}
+
+bool SessionManager::setCallback(uint32_t index, pCallbackRx p, void *pUserData)
+{
+    if ((index >= m_receivers.size()) || m_running)
+        return false;
+
+    m_receivers[index]->callback  = p;
+    m_receivers[index]->pUserData = pUserData;
+    return true;
+}
+
+bool SessionManager::start(SampleRateIndex sr)
+{
+    if (m_running)
+        return true;
+
+    atomic<uint32_t> t_started { 0 };
+    atomic<uint32_t> t_failed  { 0 };
+    forEach([this, sr, &t_started, &t_failed](Receiver &receiver) {
+        if (receiver.callback == nullptr)
+            return;
+
+        receiver.samples   = 0;
+        receiver.blocks    = 0;
+        receiver.overloads = 0;
+        receiver.rejected  = 0;
+        receiver.started   = Clock::now();
+
+        receiver.running = m_loader.start(receiver.dev, sr, &SessionManager::callbackRx, &receiver);
+        if (receiver.running)
+            ++t_started;
+        else
+            ++t_failed;
+    });
+
+    // with no receiver running the session stays stopped and start() can be retried
+    m_running = t_started != 0;
+    return m_running && (t_failed == 0);
+}
+
+void SessionManager::stop()
+{
+    if (!m_running)
+        return;
+
+    forEach([this](Receiver &receiver) {
+        if (receiver.running)
+            m_loader.stop(receiver.dev);
+        receiver.running = false;
+    });
+
+    m_running = false;
+}
+
+bool SessionManager::isRunning() const noexcept
+{
+    return m_running;
+}
+
+bool SessionManager::setFrequency(uint32_t index, uint32_t value)
+{
+    if (index >= m_receivers.size())
+        return false;
+    return m_loader.setFrequency(m_receivers[index]->dev, value);
+}
+
+bool SessionManager::setPream(uint32_t index, float value)
+{
+    if (index >= m_receivers.size())
+        return false;
+    return m_loader.setPream(m_receivers[index]->dev, value);
+}
+
+SessionStatistics SessionManager::statistics(uint32_t index) const
+{
+    SessionStatistics t_stat;
+    if (index >= m_receivers.size())
+        return t_stat;
+
+    const Receiver &receiver = *m_receivers[index];
+    t_stat.samples     = receiver.samples;
+    t_stat.blocks      = receiver.blocks;
+    t_stat.overloads   = receiver.overloads;
+    t_stat.rejected    = receiver.rejected;
+    t_stat.samplesLost = m_loader.callbackStatistics(receiver.dev).samplesLost;
+
+    if (receiver.running) {
+        const double t_elapsed = chrono::duration<double>(Clock::now() - receiver.started).count();
+        if (t_elapsed > 0)
+            t_stat.throughput = t_stat.samples/t_elapsed;
+    }
+
+    return t_stat;
+}
+
+SessionStatistics SessionManager::statistics() const
+{
+    SessionStatistics t_total;
+    for (uint32_t i = 0; i < count(); ++i) {
+        const SessionStatistics t_stat = statistics(i);
+        t_total.samples     += t_stat.samples;
+        t_total.blocks      += t_stat.blocks;
+        t_total.overloads   += t_stat.overloads;
+        t_total.rejected    += t_stat.rejected;
+        t_total.samplesLost += t_stat.samplesLost;
+        t_total.throughput  += t_stat.throughput;
+    }
+
+    return t_total;
+}
+
+bool SessionManager::callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData)
+{
+    Receiver &receiver = *static_cast<Receiver*>(pUserData);
+
+    receiver.samples.fetch_add(len, memory_order_relaxed);
+    receiver.blocks.fetch_add(1, memory_order_relaxed);
+    if (adcOverload)
+        receiver.overloads.fetch_add(1, memory_order_relaxed);
+
+    const bool t_result = receiver.callback(pSrc, len, adcOverload, receiver.pUserData);
+    if (!t_result)
+        receiver.rejected.fetch_add(1, memory_order_relaxed);
+
+    return t_result;
+}
+
+void SessionManager::forEach(const function<void(Receiver&)> &func)
+{
+    if (m_receivers.size() == 1) {
+        func(*m_receivers.front());
+        return;
+    }
+
+    // start/stop of one receiver waits for its USB transfers and library threads,
+    // LibLoader lets calls for different descriptors run concurrently
+    vector<thread> t_threads;
+    t_threads.reserve(m_receivers.size());
+    for (const auto &receiver : m_receivers)
+        t_threads.emplace_back(func, ref(*receiver));
+
+    for (thread &t : t_threads)
+        t.join();
+}
@@ -0,0 +1,159 @@
+#ifndef SESSIONMANAGER_H
+#define SESSIONMANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "LibLoader.h"
+
+using namespace std;
+
+/**
+ * \brief Streaming counters of one receiver or of the whole session.
+ *
+ * \details samplesLost is taken from LibLoader::callbackStatistics(), throughput is
+ * the average rate of delivered samples since start, samples per second.
+ */
+struct SessionStatistics
+{
+    uint64_t samples     { 0 };   ///< samples delivered to the callback
+    uint64_t blocks      { 0 };   ///< callback invocations
+    uint64_t overloads   { 0 };   ///< blocks with ADC overload flag
+    uint64_t rejected    { 0 };   ///< blocks the callback returned false for
+    uint64_t samplesLost { 0 };   ///< samples estimated as discarded upstream
+    double   throughput  { 0 };   ///< samples per second
+};
+
+/**
+ * \brief Streaming session of all connected ColibriNANO receivers.
+ *
+ * \details The session opens every receiver reported by LibLoader::devices() and
+ * streams them at the same sample rate. Each receiver gets its own callback and
+ * pUserData, set by setCallback() before start(). Start and stop are issued to all
+ * receivers in parallel, one thread per receiver, so the restart time of a rack
+ * does not grow with the number of receivers. Open and close change the descriptor
+ * list of the library, which LibLoader runs exclusively, so they are done one after
+ * another in order of device index; close() first stops all receivers in parallel.
+ *
+ * \code
+ * SessionManager t_session(m_loader);
+ * t_session.open();
+ * for (uint32_t i = 0; i < t_session.count(); ++i)
+ *     t_session.setCallback(i, Receiver::callbackRx, &m_receivers[i]);
+ * t_session.start(Sr_1920kHz);
+ * \endcode
+ */
+class SessionManager
+{
+public:
+    explicit SessionManager(LibLoader &loader);
+    ~SessionManager();
+
+    /**
+     * \brief Open all found receivers.
+     * \return amount of opened receivers.
+     *
+     * \details Receivers that failed to open are skipped, device() returns
+     * the library index of every opened receiver.
+     */
+    uint32_t open();
+
+    /**
+     * \brief Stop and close all receivers.
+     */
+    void close();
+
+    /**
+     * \brief Return amount of opened receivers.
+     */
+    uint32_t count() const noexcept;
+
+    /**
+     * \brief Return library device index of the opened receiver.
+     */
+    uint32_t device(uint32_t index) const noexcept;
+
+    /**
+     * \brief Return descriptor of the opened receiver.
+     */
+    Descriptor descriptor(uint32_t index) const noexcept;
+
+    /**
+     * \brief Set IQ callback of the opened receiver.
+     * \param index - receiver's number in the session.
+     * \param p - callback.
+     * \param pUserData - user data passed to the callback.
+     *
+     * \details Takes effect from the next start().
+     */
+    bool setCallback(uint32_t index, pCallbackRx p, void *pUserData);
+
+    /**
+     * \brief Start IQ stream of all receivers with a callback.
+     * \return true if all of them started.
+     *
+     * \details If no receiver started the session stays stopped.
+     */
+    bool start(SampleRateIndex sr);
+
+    /**
+     * \brief Stop IQ stream of all receivers.
+     */
+    void stop();
+
+    bool isRunning() const noexcept;
+
+    bool setFrequency(uint32_t index, uint32_t value);
+    bool setPream(uint32_t index, float value);
+
+    /**
+     * \brief Return counters of the opened receiver since the last start().
+     */
+    SessionStatistics statistics(uint32_t index) const;
+
+    /**
+     * \brief Return counters summed over all receivers.
+     */
+    SessionStatistics statistics() const;
+
+private:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * \brief Receiver of the session, passed to LibLoader::start() as pUserData.
+     */
+    struct Receiver
+    {
+        SessionManager *pSession  { nullptr };
+        uint32_t        device    { 0 };
+        Descriptor      dev       { nullptr };
+        pCallbackRx     callback  { nullptr };
+        void           *pUserData { nullptr };
+        bool            running   { false };
+
+        Clock::time_point started;
+
+        atomic<uint64_t> samples   { 0 };
+        atomic<uint64_t> blocks    { 0 };
+        atomic<uint64_t> overloads { 0 };
+        atomic<uint64_t> rejected  { 0 };
+    };
+
+    SessionManager(const SessionManager &) = delete;
+    SessionManager &operator=(const SessionManager &) = delete;
+
+    static bool callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData);
+
+    void forEach(const function<void(Receiver&)> &func);
+
+private:
+    LibLoader &m_loader;
+    vector<unique_ptr<Receiver>> m_receivers;
+    bool m_running { false };
+};
+
+#endif // SESSIONMANAGER_H
@@ -0,0 +1,93 @@
+#ifndef __linux__
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+#include "ThreadPolicy.h"
+
+#ifndef __linux__
+
+namespace {
+
+// SetThreadDescription exists since Windows 10 1607, it is resolved at run time
+typedef HRESULT (WINAPI *pSetThreadDescription)(HANDLE, PCWSTR);
+
+bool setName(const string &name)
+{
+    static const pSetThreadDescription setDescription = reinterpret_cast<pSetThreadDescription>(
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+    if (setDescription == nullptr)
+        return false;
+
+    const wstring t_name(name.begin(), name.end());
+    return SUCCEEDED(setDescription(GetCurrentThread(), t_name.c_str()));
+}
+
+}
+
+ThreadPolicyResult applyThreadPolicy(const ThreadPolicy &policy)
+{
+    ThreadPolicyResult t_result;
+    t_result.applied = true;
+
+    if (policy.affinity)
+        t_result.affinity = SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(policy.affinity)) != 0;
+
+    if (policy.scheduling != ThreadPolicy::Default)
+        t_result.realtime = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+
+    if (!t_result.realtime && policy.nice) {
+        const int t_priority = policy.nice < 0 ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_BELOW_NORMAL;
+        t_result.nice = SetThreadPriority(GetCurrentThread(), t_priority) != 0;
+    }
+
+    if (!policy.name.empty())
+        t_result.name = setName(policy.name);
+
+    return t_result;
+}
+
+#else
+
+ThreadPolicyResult applyThreadPolicy(const ThreadPolicy &policy)
+{
+    ThreadPolicyResult t_result;
+    t_result.applied = true;
+
+    if (policy.affinity) {
+        cpu_set_t t_set;
+        CPU_ZERO(&t_set);
+        for (int i = 0; i < 64; ++i) {
+            if (policy.affinity & (uint64_t(1) << i))
+                CPU_SET(i, &t_set);
+        }
+        t_result.affinity = pthread_setaffinity_np(pthread_self(), sizeof(t_set), &t_set) == 0;
+    }
+
+    if (policy.scheduling != ThreadPolicy::Default) {
+        const int t_policy = policy.scheduling == ThreadPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+        sched_param t_param;
+        t_param.sched_priority = policy.priority;
+        if (t_param.sched_priority < sched_get_priority_min(t_policy))
+            t_param.sched_priority = sched_get_priority_min(t_policy);
+        if (t_param.sched_priority > sched_get_priority_max(t_policy))
+            t_param.sched_priority = sched_get_priority_max(t_policy);
+        t_result.realtime = pthread_setschedparam(pthread_self(), t_policy, &t_param) == 0;
+    }
+
+    // on Linux the nice value of a thread is set through its tid
+    if (!t_result.realtime && policy.nice)
+        t_result.nice = setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), policy.nice) == 0;
+
+    if (!policy.name.empty())
+        t_result.name = pthread_setname_np(pthread_self(), policy.name.substr(0, 15).c_str()) == 0;
+
+    return t_result;
+}
+
+#endif
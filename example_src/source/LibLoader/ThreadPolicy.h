@@ -0,0 +1,51 @@
+#ifndef THREADPOLICY_H
+#define THREADPOLICY_H
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/**
+ * \brief Scheduling settings of a streaming thread.
+ *
+ * \details Every field is optional: affinity 0, Default scheduling, nice 0 and an
+ * empty name leave the corresponding setting unchanged. Real-time scheduling needs
+ * CAP_SYS_NICE or an rtprio limit on Linux; when it is not permitted and nice is not
+ * 0, the thread nice value is set instead (negative values need the same rights,
+ * positive ones always work).
+ */
+struct ThreadPolicy
+{
+    enum Scheduling
+    {
+        Default = 0,
+        Fifo,           ///< SCHED_FIFO, on Windows THREAD_PRIORITY_TIME_CRITICAL
+        RoundRobin      ///< SCHED_RR, on Windows THREAD_PRIORITY_TIME_CRITICAL
+    };
+
+    uint64_t   affinity   { 0 };         ///< mask of allowed CPUs, bit N - CPU N
+    Scheduling scheduling { Default };
+    int        priority   { 0 };         ///< real-time priority 1..99
+    int        nice       { 0 };         ///< fallback nice value -20..19, on Windows above/below normal
+    string     name;                     ///< thread name, Linux keeps 15 characters
+};
+
+/**
+ * \brief Settings of ThreadPolicy that took effect.
+ */
+struct ThreadPolicyResult
+{
+    bool applied  { false };    ///< the policy reached the thread
+    bool affinity { false };
+    bool realtime { false };
+    bool nice     { false };
+    bool name     { false };
+};
+
+/**
+ * \brief Apply the policy to the calling thread.
+ */
+ThreadPolicyResult applyThreadPolicy(const ThreadPolicy &policy);
+
+#endif // THREADPOLICY_H
@@ -30,5 +30,73 @@ typedef enum
 
 typedef bool (*pCallbackRx)(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData);
 
+typedef enum
+{
+    Sf_Float32 = 0,     // Complex, re/im float
+    Sf_Int16,           // re/im int16_t
+    Sf_Int8,            // re/im int8_t
+    Sf_Int32,           // re/im int32_t, 24-bit range
+
+    SampleFormatsCount
+}SampleFormat;
+
+typedef enum
+{
+    Ring_Driver = 0,      // USB reads -> parser
+    Ring_Parser,          // parser -> Dsp thread
+    Ring_Dsp,             // Dsp thread -> callback
+
+    RingsCount
+}RingIndex;
+
+typedef struct
+{
+    uint32_t capacity;    // complex samples
+    uint32_t highWater;   // largest fill since start, complex samples
+    uint64_t overflows;   // writes that did not fit, the samples were dropped
+    uint32_t fill;        // current fill, complex samples
+}RingStatistics;
+
+// Options of start_ex. The struct crosses the library ABI: fixed-width fields only,
+// new fields are appended at the end, existing ones are never moved or removed.
+// size is set by LibLoader::startEx(), the library uses the fields within size.
+typedef struct
+{
+    uint32_t     size;            // sizeof(StreamOptions) of the caller
+    uint32_t     format;          // SampleFormat
+    float        scale;           // value of one integer step in units of Sf_Float32, set by start_ex
+    uint32_t     transferBits;    // USB sample width: 16 (default, 0 means 16), 8 - byte mode, 24 - up to 384 kHz; set to the width in use
+    uint32_t     effectiveBits;   // resolution of delivered samples, set by start_ex
+    uint32_t     fused;           // 1 - call the callback from the parsing thread, without the Dsp thread
+
+    // USB transfer parameters, 0 - library default
+    uint32_t     transferSize;    // bytes of one USB transfer, multiple of 64, 64..65536
+    uint32_t     transfers;       // transfers in flight, 1..64
+    uint32_t     latencyTimer;    // FTDI latency timer, 2..255 ms
+    uint32_t     blockSize;       // complex samples per callback, set by start_ex
+    uint32_t     reserved;        // must be 0
+    uint32_t     ringMs[RingsCount];  // capacity of the internal rings in ms of stream at the chosen rate, 0 - library default
+    uint32_t     ignored;         // StreamOptionFlag mask of requested options that had no effect, set by startEx
+}StreamOptions;
+
+typedef enum
+{
+    So_TransferBits = 0x01,       // transferBits other than 16
+    So_Fused        = 0x02,
+    So_UsbTransfer  = 0x04,       // transferSize, transfers or latencyTimer
+    So_RingMs       = 0x10        // any of ringMs
+}StreamOptionFlag;
+
+typedef enum
+{
+    Usb_Default = 0,
+    Usb_LowLatency,       // small transfers, short latency timer: small callback blocks
+    Usb_MaxThroughput,    // large transfers, deep queue: robust recording on busy hubs
+
+    UsbPresetsCount
+}UsbPreset;
+
+typedef bool (*pCallbackRxEx)(const void *pSrc, uint32_t len, bool adcOverload, void *pUserData);
+
 
 #endif // COMMON_H
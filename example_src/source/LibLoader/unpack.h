@@ -0,0 +1,74 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief Block converters between USB sample words and callback formats.
+ *
+ * \details Every converter handles a whole block with a plain loop without state
+ * between bytes, so the compiler vectorizes it. count is the amount of real values,
+ * for complex samples it is 2*len (re and im are interleaved). USB words are little
+ * endian: 8-bit words are int8, 16-bit words are int16, 24-bit words are three bytes
+ * of a signed value, re first.
+ */
+namespace Unpack {
+
+inline void unpack8(const uint8_t *pSrc, float *pDst, uint32_t count, float scale) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i)
+        pDst[i] = static_cast<int8_t>(pSrc[i])*scale;
+}
+
+inline void unpack16(const uint8_t *pSrc, float *pDst, uint32_t count, float scale) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const int16_t t_value = static_cast<int16_t>(pSrc[2*i] | (pSrc[2*i + 1] << 8));
+        pDst[i] = t_value*scale;
+    }
+}
+
+inline void unpack16(const uint8_t *pSrc, int16_t *pDst, uint32_t count) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i)
+        pDst[i] = static_cast<int16_t>(pSrc[2*i] | (pSrc[2*i + 1] << 8));
+}
+
+inline void unpack24(const uint8_t *pSrc, int32_t *pDst, uint32_t count) noexcept
+{
+    // the 24-bit value is placed in the high bytes and shifted back to extend the sign
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t t_word = (static_cast<uint32_t>(pSrc[3*i]) << 8) |
+                                (static_cast<uint32_t>(pSrc[3*i + 1]) << 16) |
+                                (static_cast<uint32_t>(pSrc[3*i + 2]) << 24);
+        pDst[i] = static_cast<int32_t>(t_word) >> 8;
+    }
+}
+
+inline void unpack24(const uint8_t *pSrc, float *pDst, uint32_t count, float scale) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t t_word = (static_cast<uint32_t>(pSrc[3*i]) << 8) |
+                                (static_cast<uint32_t>(pSrc[3*i + 1]) << 16) |
+                                (static_cast<uint32_t>(pSrc[3*i + 2]) << 24);
+        pDst[i] = (static_cast<int32_t>(t_word) >> 8)*scale;
+    }
+}
+
+/**
+ * \brief Float to integer with saturation, value range -1..1 maps to -fullScale..fullScale.
+ */
+template <typename T>
+inline void pack(const float *pSrc, T *pDst, uint32_t count, float fullScale) noexcept
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const float t_value = pSrc[i] > 1.0f ? 1.0f : (pSrc[i] < -1.0f ? -1.0f : pSrc[i]);
+        pDst[i] = static_cast<T>(lrintf(t_value*fullScale));
+    }
+}
+
+}
+
+#endif // UNPACK_H
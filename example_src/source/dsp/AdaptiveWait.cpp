@@ -0,0 +1,99 @@
+#ifndef __linux__
+#  include <windows.h>
+#else
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#  include <emmintrin.h>
+#  define ADAPTIVEWAIT_PAUSE() _mm_pause()
+#else
+#  define ADAPTIVEWAIT_PAUSE()
+#endif
+
+#include "AdaptiveWait.h"
+
+namespace SDR {
+
+namespace {
+
+// futex и WaitOnAddress работают с адресом значения atomic<uint32_t>
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> must be lock-free 32-bit");
+
+inline void *address(const atomic<uint32_t> &word) noexcept
+{
+    return const_cast<void*>(static_cast<const volatile void*>(&word));
+}
+
+#ifndef __linux__
+// WaitOnAddress есть начиная с Windows 8, на XP и 7 функции отсутствуют, поэтому
+// они ищутся во время работы, а не подключаются через synchronization.lib
+typedef BOOL (WINAPI *pWaitOnAddress)(volatile VOID*, PVOID, SIZE_T, DWORD);
+typedef VOID (WINAPI *pWakeByAddressAll)(PVOID);
+
+struct AddressApi
+{
+    pWaitOnAddress    wait    { nullptr };
+    pWakeByAddressAll wakeAll { nullptr };
+};
+
+const AddressApi &addressApi() noexcept
+{
+    static const AddressApi t_api = [] {
+        AddressApi api;
+        HMODULE hModule = LoadLibraryW(L"api-ms-win-core-synch-l1-2-0.dll");
+        if (hModule) {
+            api.wait    = reinterpret_cast<pWaitOnAddress>(GetProcAddress(hModule, "WaitOnAddress"));
+            api.wakeAll = reinterpret_cast<pWakeByAddressAll>(GetProcAddress(hModule, "WakeByAddressAll"));
+        }
+        if (!api.wait || !api.wakeAll)
+            api = AddressApi();
+        return api;
+    }();
+
+    return t_api;
+}
+#endif
+
+}
+
+void AdaptiveWait::pause() noexcept
+{
+    ADAPTIVEWAIT_PAUSE();
+}
+
+void AdaptiveWait::sleep(const atomic<uint32_t> &word, uint32_t expected, chrono::nanoseconds timeout) noexcept
+{
+#ifndef __linux__
+    const AddressApi &api = addressApi();
+    if (api.wait) {
+        const DWORD t_ms = static_cast<DWORD>(chrono::duration_cast<chrono::milliseconds>(timeout).count()) + 1;
+        api.wait(address(word), &expected, sizeof(expected), t_ms);
+    }
+    else if (word.load(memory_order_acquire) == expected) {
+        // без WaitOnAddress слово опрашивается с интервалом 1 мс
+        Sleep(1);
+    }
+#else
+    timespec t_timeout;
+    t_timeout.tv_sec  = static_cast<time_t>(timeout.count()/1000000000);
+    t_timeout.tv_nsec = static_cast<long>(timeout.count()%1000000000);
+    syscall(SYS_futex, address(word), FUTEX_WAIT_PRIVATE, expected, &t_timeout, nullptr, 0);
+#endif
+}
+
+void AdaptiveWait::wakeAll(const atomic<uint32_t> &word) noexcept
+{
+#ifndef __linux__
+    const AddressApi &api = addressApi();
+    if (api.wakeAll)
+        api.wakeAll(address(word));
+#else
+    syscall(SYS_futex, address(word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+}
@@ -0,0 +1,93 @@
+#ifndef ADAPTIVEWAIT_H
+#define ADAPTIVEWAIT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \class AdaptiveWait
+ * \brief Ожидание изменения 32-битного слова: сначала активное, затем в ядре.
+ *
+ * \details Ожидающий поток несколько сотен итераций проверяет условие с инструкцией
+ * pause, затем засыпает на слове (futex в Linux, WaitOnAddress в Windows 8 и новее,
+ * в более старых Windows - короткий Sleep). Публикующий поток изменяет слово и
+ * вызывает wake(), системный вызов выполняется только при наличии спящих потоков,
+ * поэтому при непрерывном потоке данных блокировок и системных вызовов нет.
+ */
+class AdaptiveWait
+{
+public:
+    static constexpr uint32_t SpinCount = 256;
+
+    /**
+     * \brief Ожидание выполнения условия.
+     * \param word - слово, которое изменяет публикующий поток перед wake().
+     * \param waiters - счётчик спящих потоков этого слова.
+     * \param pred - условие.
+     * \param timeout - максимальное время ожидания.
+     * \return значение условия.
+     */
+    template <typename Pred>
+    static bool wait(const atomic<uint32_t> &word, atomic<uint32_t> &waiters, Pred pred, chrono::nanoseconds timeout)
+    {
+        if (pred())
+            return true;
+
+        if (timeout <= chrono::nanoseconds::zero())
+            return false;
+
+        for (uint32_t i = 0; i < SpinCount; ++i) {
+            pause();
+            if (pred())
+                return true;
+        }
+
+        const auto t_deadline = chrono::steady_clock::now() + timeout;
+        while (true) {
+            // слово читается до проверки условия: его изменение после проверки прервёт сон
+            const uint32_t t_word = word.load(memory_order_acquire);
+            waiters.fetch_add(1, memory_order_seq_cst);
+
+            if (pred()) {
+                waiters.fetch_sub(1, memory_order_relaxed);
+                return true;
+            }
+
+            const auto t_now = chrono::steady_clock::now();
+            if (t_now >= t_deadline) {
+                waiters.fetch_sub(1, memory_order_relaxed);
+                return false;
+            }
+
+            sleep(word, t_word, chrono::duration_cast<chrono::nanoseconds>(t_deadline - t_now));
+            waiters.fetch_sub(1, memory_order_relaxed);
+
+            if (pred())
+                return true;
+        }
+    }
+
+    /**
+     * \brief Пробуждение потоков, спящих на слове, вызывается после изменения слова.
+     */
+    static void wake(const atomic<uint32_t> &word, const atomic<uint32_t> &waiters) noexcept
+    {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (waiters.load(memory_order_relaxed))
+            wakeAll(word);
+    }
+
+private:
+    static void pause() noexcept;
+    static void sleep(const atomic<uint32_t> &word, uint32_t expected, chrono::nanoseconds timeout) noexcept;
+    static void wakeAll(const atomic<uint32_t> &word) noexcept;
+};
+
+}
+
+#endif // ADAPTIVEWAIT_H
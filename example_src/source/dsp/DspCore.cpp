@@ -7,10 +7,12 @@ DspCore& DspCore::instance()
 }
 
 DspCore::DspCore(QObject *parent) :
-  QThread(parent)
+  QThread(parent),
+  m_profiler({ "write", "read", "window", "fft", "rotate", "lock", "log" })
 {
     m_fft.setSize(SpectrumSize);
     m_windows.setParam(SpectrumSize);
+    m_iqSpectrumBuffer.setMemoryFlags(SDR::RingMemory::Mirrored | SDR::RingMemory::Prefault | SDR::RingMemory::Locked);
     m_iqSpectrumBuffer.resize(SpectrumSize);
     m_spectrum.resize(SpectrumSize);
     m_signal.resize(SpectrumSize);
@@ -27,6 +29,8 @@ void DspCore::open()
         return;
 
     m_open = true;
+    if (!m_pipeline.isEmpty())
+        m_pipeline.start();
     start();
 }
 
@@ -39,6 +43,8 @@ void DspCore::close()
 
     quit();
     wait();
+
+    m_pipeline.stop();
 }
 
 bool DspCore::isOpen() const
@@ -48,7 +54,11 @@ bool DspCore::isOpen() const
 
 bool DspCore::callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pUserData)
 {
-    DspCore::instance().m_iqSpectrumBuffer.write(pSrc, len);
+    {
+        SDR::StageProfiler::Scope t_scope(DspCore::instance().m_profiler, StageWrite);
+        DspCore::instance().m_iqSpectrumBuffer.write(pSrc, len);
+    }
+    DspCore::instance().m_pipeline.push(pSrc, len);
     DspCore::instance().setAdcOverload(adcOverload);
 
     return true;
@@ -56,6 +66,8 @@ bool DspCore::callbackRx(Complex *pSrc, uint32_t len, bool adcOverload, void *pU
 
 void DspCore::run()
 {
+    m_lastLog = SDR::StageProfiler::Clock::now();
+
     QTimer t_timer;
     auto c = connect(&t_timer, &QTimer::timeout, this, &DspCore::process, Qt::DirectConnection);
     t_timer.start(50);
@@ -67,16 +79,44 @@ void DspCore::run()
 
 void DspCore::process()
 {
-    m_iqSpectrumBuffer.readAll(m_signal);
+    logStatistics();
 
-    m_windows.process(m_signal);
-    m_fft.process(m_signal, true);
-    rotate(m_signal.begin(), m_signal.begin() + SpectrumSize/2, m_signal.end());
+    SDR::SpectrumRingBuffer<Complex>::ReadSpan t_span;
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageRead);
+        if (!m_iqSpectrumBuffer.acquireRead(t_span))
+            return;
+    }
 
-    lock_guard<std::mutex> t_locker(m_mutex);
+    // окно применяется прямо к памяти кольцевого буфера
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageWindow);
+        m_windows.process(t_span.pData[0], m_signal.data(), 0, t_span.len[0]);
+        m_windows.process(t_span.pData[1], m_signal.data() + t_span.len[0], t_span.len[0], t_span.len[1]);
+        m_iqSpectrumBuffer.releaseRead();
+    }
 
-    for (size_t i = 0; i < m_signal.size(); ++i)
-        m_spectrum[i] = 5*log(m_signal[i].re*m_signal[i].re + m_signal[i].im*m_signal[i].im);
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageFft);
+        m_fft.process(m_signal.data(), static_cast<uint32_t>(m_signal.size()), true);
+    }
+
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageRotate);
+        rotate(m_signal.begin(), m_signal.begin() + SpectrumSize/2, m_signal.end());
+    }
+
+    unique_lock<std::mutex> t_locker(m_mutex, defer_lock);
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageLock);
+        t_locker.lock();
+    }
+
+    {
+        SDR::StageProfiler::Scope t_scope(m_profiler, StageLog);
+        for (size_t i = 0; i < m_signal.size(); ++i)
+            m_spectrum[i] = 5*log(m_signal[i].re*m_signal[i].re + m_signal[i].im*m_signal[i].im);
+    }
 
     emit readyRead();
 }
@@ -91,19 +131,76 @@ void DspCore::getSpectrum(vector<Real> &data)
     std::copy(m_spectrum.begin(), m_spectrum.end(), data.begin());
 }
 
-void DspCore::setAdcOverload(bool state)
+SDR::Pipeline &DspCore::pipeline()
 {
-    if (m_adcOverload != state) {
-        m_adcOverload = state;
-        emit adcOverloadChanged(state);
+    return m_pipeline;
+}
+
+const SDR::BroadcastRingBuffer<Complex> *DspCore::iqStream()
+{
+    if (!m_iqStream) {
+        if (m_open)
+            return nullptr;
+
+        auto t_stage = make_shared<SDR::BroadcastStage>(StreamBufferSize);
+        if (!m_pipeline.addStage(t_stage) || !m_pipeline.connectSource(t_stage.get()))
+            return nullptr;
+
+        m_iqStream = t_stage;
     }
+
+    return &m_iqStream->buffer();
 }
 
+bool DspCore::setFused(bool fused)
+{
+    if (m_open)
+        return false;
 
+    return m_pipeline.setFused(fused);
+}
 
+bool DspCore::isFused() const
+{
+    return m_pipeline.isFused();
+}
 
+vector<SDR::StageStatistics> DspCore::stageStatistics() const
+{
+    return m_profiler.statistics();
+}
 
+void DspCore::setAdcOverload(bool state)
+{
+    if (m_adcOverload != state) {
+        m_adcOverload = state;
+        emit adcOverloadChanged(state);
+    }
+}
 
+void DspCore::logStatistics()
+{
+    auto t_now = SDR::StageProfiler::Clock::now();
+    if (t_now - m_lastLog < chrono::milliseconds(StatisticsLogInterval))
+        return;
 
+    m_lastLog = t_now;
 
+    // формат: имя=p50/p99/max в микросекундах
+    QString t_line = QStringLiteral("DspCore stages (p50/p99/max us):");
+    for (const auto &stage : m_profiler.statistics()) {
+        t_line += QStringLiteral(" %1=%2/%3/%4")
+                  .arg(stage.name)
+                  .arg(stage.p50/1000.0, 0, 'f', 1)
+                  .arg(stage.p99/1000.0, 0, 'f', 1)
+                  .arg(stage.max/1000.0, 0, 'f', 1);
+    }
 
+    qInfo().noquote() << t_line;
+    qInfo().noquote() << QStringLiteral("DspCore spectrum ring: written=%1 overwritten=%2 skipped=%3 dropped=%4 underruns=%5")
+                         .arg(m_iqSpectrumBuffer.writeIndex())
+                         .arg(m_iqSpectrumBuffer.overwritten())
+                         .arg(m_iqSpectrumBuffer.skipped())
+                         .arg(m_iqSpectrumBuffer.dropped())
+                         .arg(m_iqSpectrumBuffer.underruns());
+}
@@ -11,6 +11,10 @@
 #include "fft.h"
 #include "window.h"
 #include "spectrumringbuffer.h"
+#include "broadcastringbuffer.h"
+#include "streamallocator.h"
+#include "Pipeline.h"
+#include "stageprofiler.h"
 
 
 
@@ -21,6 +25,21 @@ class DspCore : public QThread
 
 public:
     static constexpr size_t SpectrumSize = 4096;
+    static constexpr size_t StreamBufferSize = 1 << 20;          // ~340 мс при 3072 кГц
+    static constexpr int    StatisticsLogInterval = 10000;     // мс
+
+    enum Stage : uint32_t
+    {
+        StageWrite = 0,     // запись в кольцевой буфер из callbackRx
+        StageRead,
+        StageWindow,
+        StageFft,
+        StageRotate,
+        StageLock,          // ожидание m_mutex
+        StageLog,
+
+        StagesCount
+    };
 
 public:
     static DspCore& instance();
@@ -35,6 +54,32 @@ public:
 
     void getSpectrum(vector<Real> &data);
 
+    SDR::Pipeline &pipeline();
+
+    /**
+     * \brief IQ поток для потребителей, читающих его в своём темпе (запись, сеть).
+     * \return nullptr, если ступень не подключена к уже открытому потоку.
+     *
+     * \details При первом вызове к pipeline() подключается SDR::BroadcastStage,
+     * поэтому вызов выполняется до open(). Каждый потребитель создаёт собственный
+     * SDR::BroadcastRingBuffer<Complex>::Reader. Пока потребителей нет, буфер не
+     * выделяется, а callbackRx пишет только буфер спектра.
+     */
+    const SDR::BroadcastRingBuffer<Complex> *iqStream();
+
+    /**
+     * \brief Включение совмещённого режима pipeline() (SDR::Pipeline::setFused()).
+     * \return false, если поток уже открыт.
+     *
+     * \details Ступени вычисляются в потоке callbackRx без рабочих потоков, а
+     * BroadcastStage получает блок библиотеки без копирования во входной слот.
+     * Время обработки блока добавляется ко времени callbackRx.
+     */
+    bool setFused(bool fused);
+    bool isFused() const;
+
+    vector<SDR::StageStatistics> stageStatistics() const;
+
 signals:
     void readyRead();
     void adcOverloadChanged(bool);
@@ -50,6 +95,7 @@ private:
     Q_DISABLE_COPY(DspCore);
 
     void setAdcOverload(bool state);
+    void logStatistics();
 
 private:
     bool        m_open { false };
@@ -58,11 +104,15 @@ private:
     fft    m_fft;
     Window m_windows;
     SDR::SpectrumRingBuffer<Complex> m_iqSpectrumBuffer;
+    SDR::Pipeline m_pipeline;
+    shared_ptr<SDR::BroadcastStage> m_iqStream;
+    SDR::StageProfiler m_profiler;
+    SDR::StageProfiler::Clock::time_point m_lastLog;
 
     std::mutex m_mutex;
 
-    vector<Complex> m_signal;
-    vector<Real>    m_spectrum;
+    vector<Complex, SDR::StreamAllocator<Complex>> m_signal;
+    vector<Real, SDR::StreamAllocator<Real>>       m_spectrum;
 };
 
 #endif // DSPCORE_H
@@ -0,0 +1,418 @@
+#include <cstring>
+
+#include "Pipeline.h"
+
+namespace SDR {
+
+constexpr chrono::milliseconds Pipeline::FeedTimeout;
+
+PipelineStage::PipelineStage(const vector<PortType> &inputs, PortType output, uint32_t maxBlockSize) :
+  m_inputTypes(inputs),
+  m_outputType(output),
+  m_maxBlockSize(maxBlockSize)
+{
+    // выходной буфер выделяется один раз
+    if (m_outputType == PortType::Complex)
+        m_complexBuffer.resize(m_maxBlockSize);
+    else if (m_outputType == PortType::Real)
+        m_realBuffer.resize(m_maxBlockSize);
+
+    m_inputs.resize(m_inputTypes.size());
+    m_connected.resize(m_inputTypes.size(), false);
+    m_children.reserve(4);
+}
+
+
+Pipeline::Pipeline(uint32_t maxBlockSize, uint32_t workers, uint32_t slots) :
+  m_maxBlockSize(maxBlockSize),
+  m_workersCount(max(workers, 1u)),
+  m_slotsCount(max(slots, 1u))
+{
+    // память слотов выделяется при первом start(), неиспользуемый граф её не закрепляет
+    m_filled.resize(m_slotsCount);
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+bool Pipeline::addStage(const shared_ptr<PipelineStage> &stage)
+{
+    if (!stage || m_running || contains(stage.get()))
+        return false;
+
+    m_stages.push_back(stage);
+    m_ready.reserve(m_stages.size());
+    return true;
+}
+
+bool Pipeline::connectSource(PipelineStage *dst, uint32_t port)
+{
+    if (m_running || !contains(dst))
+        return false;
+
+    if ((port >= dst->m_inputTypes.size()) || dst->m_connected[port])
+        return false;
+
+    if (dst->m_inputTypes[port] != PortType::Complex)
+        return false;
+
+    dst->m_connected[port] = true;
+    m_sources.push_back({ dst, port });
+    return true;
+}
+
+bool Pipeline::connect(PipelineStage *src, PipelineStage *dst, uint32_t port)
+{
+    if (m_running || !contains(src) || !contains(dst) || (src == dst))
+        return false;
+
+    if ((port >= dst->m_inputTypes.size()) || dst->m_connected[port])
+        return false;
+
+    if ((src->m_outputType == PortType::None) || (dst->m_inputTypes[port] != src->m_outputType))
+        return false;
+
+    // граф должен оставаться ациклическим
+    if (reachable(dst, src))
+        return false;
+
+    dst->m_connected[port] = true;
+    src->m_children.push_back({ dst, port });
+    return true;
+}
+
+bool Pipeline::start()
+{
+    if (m_running)
+        return true;
+
+    for (const auto &stage : m_stages) {
+        for (bool connected : stage->m_connected) {
+            if (!connected)
+                return false;
+        }
+    }
+
+    // закрепление ограничено RLIMIT_MEMLOCK (по умолчанию 64 КиБ) и не обязательно:
+    // RingMemory не считает ошибку mlock/VirtualLock ошибкой выделения и снимает Locked
+    if ((m_slots.blocks() == 0) && !m_slots.allocate(m_slotsCount, m_maxBlockSize))
+        return false;
+
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+
+        m_filled.clear();
+        m_slots.reset();
+        m_acquired  = nullptr;
+        m_current   = nullptr;
+        m_feeding   = false;
+        m_remaining = 0;
+        m_ready.clear();
+    }
+
+    if (m_fused)
+        sortStages();
+
+    m_running = true;
+    if (!m_fused) {
+        m_policyResults.assign(m_workersCount, ThreadPolicyResult());
+        for (uint32_t i = 0; i < m_workersCount; ++i)
+            m_workers.emplace_back(&Pipeline::worker, this, i);
+    }
+
+    return true;
+}
+
+void Pipeline::stop()
+{
+    {
+        lock_guard<mutex> t_locker(m_mutex);
+        if (!m_running)
+            return;
+        m_running = false;
+    }
+    m_cond.notify_all();
+
+    for (thread &t : m_workers)
+        t.join();
+    m_workers.clear();
+}
+
+bool Pipeline::isRunning() const noexcept
+{
+    return m_running;
+}
+
+bool Pipeline::isEmpty() const noexcept
+{
+    return m_sources.empty();
+}
+
+bool Pipeline::setFused(bool fused) noexcept
+{
+    if (m_running)
+        return false;
+
+    m_fused = fused;
+    return true;
+}
+
+bool Pipeline::isFused() const noexcept
+{
+    return m_fused;
+}
+
+bool Pipeline::setThreadPolicy(const ThreadPolicy &policy)
+{
+    if (m_running)
+        return false;
+
+    m_policy = policy;
+    return true;
+}
+
+vector<ThreadPolicyResult> Pipeline::threadPolicyResults() const
+{
+    lock_guard<mutex> t_locker(m_mutex);
+    return m_policyResults;
+}
+
+bool Pipeline::push(const Complex *pSrc, uint32_t len) noexcept
+{
+    if (!m_running || (len == 0u))
+        return false;
+
+    if (len > m_maxBlockSize) {
+        ++m_dropped;
+        return false;
+    }
+
+    // в совмещённом режиме ступени читают данные источника на месте
+    if (m_fused) {
+        runInline({ PortType::Complex, pSrc, len });
+        return true;
+    }
+
+    Complex *pDst = acquire();
+    if (pDst == nullptr)
+        return false;
+
+    // единственное копирование потока, дальше ветви получают указатель на слот
+    memcpy(pDst, pSrc, len*sizeof(Complex));
+
+    return commit(len);
+}
+
+Complex *Pipeline::acquire() noexcept
+{
+    if (!m_running)
+        return nullptr;
+
+    if (m_acquired == nullptr)
+        m_acquired = m_slots.acquire();
+
+    if (m_acquired == nullptr) {
+        ++m_dropped;
+        return nullptr;
+    }
+
+    return m_acquired->pData;
+}
+
+bool Pipeline::commit(uint32_t len) noexcept
+{
+    if ((m_acquired == nullptr) || (len == 0u) || (len > m_maxBlockSize))
+        return false;
+
+    m_acquired->len = len;
+
+    if (m_fused) {
+        runInline({ PortType::Complex, m_acquired->pData, len });
+        m_slots.release(m_acquired);
+        m_acquired = nullptr;
+        return true;
+    }
+
+    // слотов не больше ёмкости очереди, запись всегда успешна
+    m_filled.tryWrite(&m_acquired, 1);
+    m_acquired = nullptr;
+
+    return true;
+}
+
+uint32_t Pipeline::maxBlockSize() const noexcept
+{
+    return m_maxBlockSize;
+}
+
+uint32_t Pipeline::queueSize() const noexcept
+{
+    return m_slotsCount;
+}
+
+uint32_t Pipeline::queueHighWater() const noexcept
+{
+    return m_filled.highWater();
+}
+
+uint64_t Pipeline::dropped() const noexcept
+{
+    return m_dropped;
+}
+
+void Pipeline::worker(uint32_t index)
+{
+    ThreadPolicy t_policy = m_policy;
+    if (!t_policy.name.empty())
+        t_policy.name += to_string(index);
+
+    const ThreadPolicyResult t_result = applyThreadPolicy(t_policy);
+
+    unique_lock<mutex> t_locker(m_mutex);
+    m_policyResults[index] = t_result;
+
+    while (true) {
+        m_cond.wait(t_locker, [this] {
+            return !m_running || !m_ready.empty() || (!m_current && !m_feeding);
+        });
+
+        if (!m_running)
+            break;
+
+        // один из свободных потоков ждёт входной блок вне мьютекса
+        if (m_ready.empty()) {
+            m_feeding = true;
+            t_locker.unlock();
+                Slot *pSlot = nullptr;
+                const bool t_read = m_filled.tryRead(&pSlot, 1, FeedTimeout);
+            t_locker.lock();
+            m_feeding = false;
+
+            if (t_read)
+                beginFrame(pSlot);
+            continue;
+        }
+
+        PipelineStage *pStage = m_ready.back();
+        m_ready.pop_back();
+
+        t_locker.unlock();
+            Block t_output = pStage->process(pStage->m_inputs.data(), static_cast<uint32_t>(pStage->m_inputs.size()));
+        t_locker.lock();
+
+        pStage->m_output = t_output;
+
+        // передаём результат дочерним ступеням
+        bool t_notify = false;
+        for (const auto &edge : pStage->m_children) {
+            edge.pStage->m_inputs[edge.port] = t_output;
+            if (--edge.pStage->m_pending == 0) {
+                m_ready.push_back(edge.pStage);
+                t_notify = true;
+            }
+        }
+
+        // кадр полностью обработан, освобождаем входной слот
+        if (--m_remaining == 0) {
+            m_slots.release(m_current);
+            m_current = nullptr;
+            t_notify = true;
+        }
+
+        if (t_notify)
+            m_cond.notify_all();
+    }
+}
+
+void Pipeline::beginFrame(Slot *pSlot)
+{
+    m_current = pSlot;
+
+    if (m_stages.empty()) {
+        m_slots.release(m_current);
+        m_current = nullptr;
+        return;
+    }
+
+    for (const auto &stage : m_stages)
+        stage->m_pending = static_cast<uint32_t>(stage->m_inputTypes.size());
+
+    const Block t_source { PortType::Complex, m_current->pData, m_current->len };
+    for (const auto &edge : m_sources) {
+        edge.pStage->m_inputs[edge.port] = t_source;
+        --edge.pStage->m_pending;
+    }
+
+    m_remaining = static_cast<uint32_t>(m_stages.size());
+    for (const auto &stage : m_stages) {
+        if (stage->m_pending == 0)
+            m_ready.push_back(stage.get());
+    }
+
+    m_cond.notify_all();
+}
+
+void Pipeline::runInline(const Block &source)
+{
+    for (const auto &edge : m_sources)
+        edge.pStage->m_inputs[edge.port] = source;
+
+    for (PipelineStage *pStage : m_order) {
+        const Block t_output = pStage->process(pStage->m_inputs.data(), static_cast<uint32_t>(pStage->m_inputs.size()));
+        pStage->m_output = t_output;
+
+        for (const auto &edge : pStage->m_children)
+            edge.pStage->m_inputs[edge.port] = t_output;
+    }
+}
+
+void Pipeline::sortStages()
+{
+    // топологическая сортировка: ступень идёт после всех ступеней, подключенных к её входам
+    m_order.clear();
+    m_order.reserve(m_stages.size());
+
+    for (const auto &stage : m_stages)
+        stage->m_pending = static_cast<uint32_t>(stage->m_inputTypes.size());
+    for (const auto &edge : m_sources)
+        --edge.pStage->m_pending;
+
+    for (const auto &stage : m_stages) {
+        if (stage->m_pending == 0)
+            m_order.push_back(stage.get());
+    }
+
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        for (const auto &edge : m_order[i]->m_children) {
+            if (--edge.pStage->m_pending == 0)
+                m_order.push_back(edge.pStage);
+        }
+    }
+}
+
+bool Pipeline::reachable(PipelineStage *from, PipelineStage *to) const
+{
+    if (from == to)
+        return true;
+
+    for (const auto &edge : from->m_children) {
+        if (reachable(edge.pStage, to))
+            return true;
+    }
+
+    return false;
+}
+
+bool Pipeline::contains(const PipelineStage *pStage) const
+{
+    for (const auto &stage : m_stages) {
+        if (stage.get() == pStage)
+            return true;
+    }
+
+    return false;
+}
+
+}
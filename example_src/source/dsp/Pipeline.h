@@ -0,0 +1,310 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../LibLoader/common.h"
+#include "../LibLoader/ThreadPolicy.h"
+#include "blockpool.h"
+#include "spscringbuffer.h"
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \brief Тип данных порта ступени обработки.
+ */
+enum class PortType
+{
+    None,       ///< нет данных (ступень-приёмник)
+    Complex,    ///< блок комплексных отсчётов
+    Real        ///< блок действительных отсчётов
+};
+
+/**
+ * \brief Блок данных, передаваемый между ступенями.
+ *
+ * \details Блок не владеет памятью, он только ссылается на выходной буфер
+ * ступени-источника, поэтому все ветви графа читают одну и ту же копию потока.
+ */
+struct Block
+{
+    PortType    type  { PortType::None };
+    const void *pData { nullptr };
+    uint32_t    len   { 0 };
+
+    const Complex *complex() const noexcept { return type == PortType::Complex ? static_cast<const Complex*>(pData) : nullptr; }
+    const Real    *real()    const noexcept { return type == PortType::Real    ? static_cast<const Real*>(pData)    : nullptr; }
+};
+
+
+/**
+ * \class PipelineStage
+ * \brief Ступень обработки графа Pipeline.
+ *
+ * \details Ступень имеет произвольное количество типизированных входных портов
+ * и один выходной порт. Выходной буфер выделяется заранее в конструкторе,
+ * во время работы память не выделяется.
+ */
+class PipelineStage
+{
+public:
+    /**
+     * \brief Конструктор ступени.
+     * \param inputs - типы входных портов.
+     * \param output - тип выходного порта.
+     * \param maxBlockSize - максимальный размер выходного блока.
+     */
+    PipelineStage(const vector<PortType> &inputs, PortType output, uint32_t maxBlockSize = 0);
+    virtual ~PipelineStage() = default;
+
+    const vector<PortType> &inputTypes() const noexcept { return m_inputTypes; }
+    PortType outputType() const noexcept { return m_outputType; }
+
+    /**
+     * \brief Возвращает последний вычисленный выходной блок.
+     */
+    const Block &output() const noexcept { return m_output; }
+
+protected:
+    /**
+     * \brief Обработка блока.
+     * \param pInputs - входные блоки, по одному на каждый порт.
+     * \param count - количество входных блоков.
+     * \return выходной блок.
+     *
+     * \details Вызывается из рабочего потока Pipeline. Результат записывается в
+     * complexOutput()/realOutput(), либо ступень возвращает один из входных блоков
+     * без копирования.
+     */
+    virtual Block process(const Block *pInputs, uint32_t count) = 0;
+
+    Complex *complexOutput() noexcept { return m_complexBuffer.data(); }
+    Real    *realOutput()    noexcept { return m_realBuffer.data(); }
+    uint32_t maxBlockSize() const noexcept { return m_maxBlockSize; }
+
+    Block complexBlock(uint32_t len) noexcept { return { PortType::Complex, m_complexBuffer.data(), min(len, m_maxBlockSize) }; }
+    Block realBlock(uint32_t len) noexcept    { return { PortType::Real   , m_realBuffer.data()   , min(len, m_maxBlockSize) }; }
+
+private:
+    PipelineStage(const PipelineStage &) = delete;
+    PipelineStage &operator=(const PipelineStage &) = delete;
+
+    friend class Pipeline;
+
+    struct Edge
+    {
+        PipelineStage *pStage;
+        uint32_t       port;
+    };
+
+    vector<PortType> m_inputTypes;
+    PortType         m_outputType;
+    uint32_t         m_maxBlockSize;
+
+    vector<Complex> m_complexBuffer;
+    vector<Real>    m_realBuffer;
+
+    // состояние в графе, изменяется только под мьютексом Pipeline
+    vector<Block> m_inputs;
+    vector<bool>  m_connected;
+    vector<Edge>  m_children;
+    uint32_t      m_pending { 0 };
+    Block         m_output;
+};
+
+
+/**
+ * \class Pipeline
+ * \brief Граф ступеней обработки IQ потока.
+ *
+ * \details Поток отсэмплов поступает через push() (обычно из DspCore::callbackRx)
+ * и копируется один раз в заранее выделенный входной слот. Слоты передаются между
+ * push() и рабочими потоками через очереди без блокировок (SpscRingBuffer), поэтому
+ * push() не захватывает мьютекс и не ждёт рабочие потоки. Далее ступени графа
+ * (ациклический граф) вычисляются рабочими потоками: ступень запускается, как только
+ * готовы все её входы, независимые ветви выполняются параллельно.
+ * Алгоритм работы: \n
+ *  1) Ступени добавляются методом addStage();
+ *  2) Ступени соединяются методами connectSource() и connect();
+ *  3) start() проверяет граф и запускает рабочие потоки;
+ *  4) push() ставит блок в очередь, при отсутствии свободного слота блок отбрасывается.
+ *
+ * Источник, который сам формирует отсчёты (например распаковщик USB кадров), может
+ * писать прямо во входной слот: acquire() возвращает память слота, commit() ставит
+ * его в очередь. Тогда копирование push() не выполняется совсем.
+ *
+ * В совмещённом режиме (setFused()) рабочие потоки не создаются: push()/commit()
+ * вычисляют весь граф в вызывающем потоке в топологическом порядке, а push()
+ * передаёт ступеням указатель на данные источника без копирования. Режим убирает
+ * переход между потоками и миграцию кэша на 2-ядерных системах, но время обработки
+ * блока добавляется ко времени callbackRx.
+ */
+class Pipeline
+{
+public:
+    /**
+     * \brief Конструктор.
+     * \param maxBlockSize - максимальный размер входного блока.
+     * \param workers - количество рабочих потоков.
+     * \param slots - количество входных слотов (глубина очереди).
+     */
+    explicit Pipeline(uint32_t maxBlockSize = 65536, uint32_t workers = 2, uint32_t slots = 4);
+    ~Pipeline();
+
+    /**
+     * \brief Добавление ступени в граф.
+     * \return false, если граф запущен или ступень уже добавлена.
+     */
+    bool addStage(const shared_ptr<PipelineStage> &stage);
+
+    /**
+     * \brief Подключение входного потока ко входу ступени.
+     * \param dst - ступень.
+     * \param port - номер входного порта, должен иметь тип PortType::Complex.
+     */
+    bool connectSource(PipelineStage *dst, uint32_t port = 0);
+
+    /**
+     * \brief Соединение выхода ступени src со входом port ступени dst.
+     * \return false при несовпадении типов, повторном подключении порта или появлении цикла.
+     */
+    bool connect(PipelineStage *src, PipelineStage *dst, uint32_t port = 0);
+
+    /**
+     * \brief Запуск рабочих потоков.
+     * \return false, если в графе есть неподключенные входы или не выделена память слотов.
+     */
+    bool start();
+
+    /**
+     * \brief Остановка рабочих потоков, необработанные блоки отбрасываются.
+     */
+    void stop();
+
+    bool isRunning() const noexcept;
+    bool isEmpty() const noexcept;
+
+    /**
+     * \brief Включение совмещённого режима, только при остановленном графе.
+     */
+    bool setFused(bool fused) noexcept;
+    bool isFused() const noexcept;
+
+    /**
+     * \brief Настройки рабочих потоков, применяются при start().
+     *
+     * \details К имени потока добавляется его номер.
+     */
+    bool setThreadPolicy(const ThreadPolicy &policy);
+
+    /**
+     * \brief Возвращает результат применения настроек к каждому рабочему потоку.
+     */
+    vector<ThreadPolicyResult> threadPolicyResults() const;
+
+    /**
+     * \brief Постановка блока входного потока в очередь.
+     * \return false, если граф не запущен или нет свободного слота.
+     *
+     * \details Вызывается из одного потока.
+     */
+    bool push(const Complex *pSrc, uint32_t len) noexcept;
+
+    /**
+     * \brief Получение свободного входного слота для записи на месте.
+     * \return память на maxBlockSize() отсчётов или nullptr, если слота нет (блок отброшен).
+     *
+     * \details Вызывается из потока push(), слот публикуется методом commit().
+     */
+    Complex *acquire() noexcept;
+
+    /**
+     * \brief Постановка в очередь слота, полученного acquire().
+     * \param len - количество записанных отсчётов.
+     */
+    bool commit(uint32_t len) noexcept;
+
+    uint32_t maxBlockSize() const noexcept;
+
+    /**
+     * \brief Количество входных слотов и наибольшее количество слотов в очереди после start().
+     *
+     * \details Если queueHighWater() достигает queueSize(), блоки отбрасываются
+     * (dropped()), и очередь нужно увеличить.
+     */
+    uint32_t queueSize() const noexcept;
+    uint32_t queueHighWater() const noexcept;
+
+    /**
+     * \brief Количество блоков, отброшенных из-за переполнения очереди.
+     */
+    uint64_t dropped() const noexcept;
+
+private:
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    using Slot = BlockPool<Complex>::Buffer;
+
+    struct SourceEdge
+    {
+        PipelineStage *pStage;
+        uint32_t       port;
+    };
+
+    // ожидание входного блока, по истечении проверяется m_running
+    static constexpr chrono::milliseconds FeedTimeout { 10 };
+
+    void worker(uint32_t index);
+    void beginFrame(Slot *pSlot);
+    void runInline(const Block &source);
+    void sortStages();
+    bool reachable(PipelineStage *from, PipelineStage *to) const;
+    bool contains(const PipelineStage *pStage) const;
+
+private:
+    uint32_t m_maxBlockSize;
+    uint32_t m_workersCount;
+    uint32_t m_slotsCount;
+
+    vector<shared_ptr<PipelineStage>> m_stages;
+    vector<SourceEdge>                m_sources;
+
+    // слоты берёт push(), возвращают рабочие потоки под m_mutex;
+    // m_filled пишет push(), читает один рабочий поток: он выбирается под m_mutex
+    // флагом m_feeding, а само чтение (с ожиданием FeedTimeout) выполняет вне мьютекса
+    BlockPool<Complex>    m_slots;
+    SpscRingBuffer<Slot*> m_filled;
+    Slot                 *m_acquired { nullptr };
+    Slot                 *m_current  { nullptr };
+    bool                  m_feeding  { false };
+
+    bool                   m_fused { false };
+    vector<PipelineStage*> m_order;
+
+    ThreadPolicy               m_policy;
+    vector<ThreadPolicyResult> m_policyResults;
+
+    vector<PipelineStage*> m_ready;
+    uint32_t               m_remaining { 0 };
+
+    vector<thread> m_workers;
+    atomic_bool    m_running { false };
+    atomic<uint64_t> m_dropped { 0 };
+
+    mutable mutex      m_mutex;
+    condition_variable m_cond;
+};
+
+}
+
+#endif // PIPELINE_H
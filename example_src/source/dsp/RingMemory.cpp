@@ -0,0 +1,287 @@
+#include <cstring>
+
+#ifndef __linux__
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+// memfd_create появилась в glibc 2.27, MFD_CLOEXEC объявляется вместе с ней;
+// без неё зеркальная память не создаётся и используется обычное отображение
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#  define RINGMEMORY_HAS_MEMFD
+#endif
+
+#include "RingMemory.h"
+
+namespace SDR {
+
+namespace {
+
+inline size_t alignUp(size_t value, size_t alignment) noexcept
+{
+    return (value + alignment - 1)/alignment*alignment;
+}
+
+#ifndef __linux__
+// GetLargePageMinimum отсутствует в Windows XP, поэтому она ищется во время работы
+typedef SIZE_T (WINAPI *pGetLargePageMinimum)(void);
+
+size_t largePageMinimum() noexcept
+{
+    static const pGetLargePageMinimum GetLargePageMinimumPtr = [] {
+        HMODULE hKernel = GetModuleHandleW(L"kernel32.dll");
+        return hKernel ? reinterpret_cast<pGetLargePageMinimum>(GetProcAddress(hKernel, "GetLargePageMinimum")) : nullptr;
+    }();
+
+    return GetLargePageMinimumPtr ? static_cast<size_t>(GetLargePageMinimumPtr()) : 0;
+}
+#endif
+
+}
+
+RingMemory::~RingMemory()
+{
+    release();
+}
+
+bool RingMemory::allocate(size_t bytes, uint32_t flags)
+{
+    release();
+
+    if (bytes == 0)
+        return true;
+
+    Mapping t_mapping;
+    bool t_mapped = false;
+
+    if ((flags & Mirrored) && (bytes % pageSize() == 0))
+        t_mapped = mapMirrored(bytes, flags, t_mapping);
+
+    if (!t_mapped)
+        t_mapped = map(bytes, flags & ~Mirrored, t_mapping);
+
+    if (!t_mapped)
+        return false;
+
+    finish(bytes, flags, t_mapping);
+
+    m_mapping = t_mapping;
+    m_pData   = t_mapping.pData;
+    m_size    = bytes;
+    m_flags   = t_mapping.flags;
+
+    return true;
+}
+
+void RingMemory::release() noexcept
+{
+    if (m_pData == nullptr)
+        return;
+
+    unmap(m_mapping);
+
+    m_mapping = Mapping();
+    m_pData   = nullptr;
+    m_size    = 0;
+    m_flags   = 0;
+}
+
+size_t RingMemory::pageSize() noexcept
+{
+#ifndef __linux__
+    static const size_t PageSize = [] {
+        SYSTEM_INFO t_info;
+        GetSystemInfo(&t_info);
+        return static_cast<size_t>(t_info.dwPageSize);
+    }();
+#else
+    static const size_t PageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return PageSize;
+}
+
+void *RingMemory::allocateBlock(size_t bytes, uint32_t flags) noexcept
+{
+    // в начале отображения хранится его описание, данные начинаются через Alignment байт
+    static_assert(sizeof(Mapping) <= Alignment, "Mapping header does not fit");
+
+    Mapping t_mapping;
+    if (!map(bytes + Alignment, flags & ~Mirrored, t_mapping))
+        return nullptr;
+
+    finish(bytes + Alignment, flags, t_mapping);
+    memcpy(t_mapping.pBase, &t_mapping, sizeof(Mapping));
+
+    return static_cast<uint8_t*>(t_mapping.pBase) + Alignment;
+}
+
+void RingMemory::releaseBlock(void *pData) noexcept
+{
+    if (pData == nullptr)
+        return;
+
+    Mapping t_mapping;
+    memcpy(&t_mapping, static_cast<uint8_t*>(pData) - Alignment, sizeof(Mapping));
+    unmap(t_mapping);
+}
+
+bool RingMemory::map(size_t bytes, uint32_t flags, Mapping &mapping) noexcept
+{
+    mapping = Mapping();
+
+#ifndef __linux__
+    // большие страницы Windows требуют привилегии SeLockMemoryPrivilege
+    if (flags & HugePages) {
+        const size_t t_large = largePageMinimum();
+        if (t_large) {
+            const size_t t_length = alignUp(bytes, t_large);
+            void *p = VirtualAlloc(nullptr, t_length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (p) {
+                mapping.pData  = p;
+                mapping.pBase  = p;
+                mapping.length = t_length;
+                mapping.flags  = HugePages;
+                return true;
+            }
+        }
+    }
+
+    const size_t t_length = alignUp(bytes, pageSize());
+    void *p = VirtualAlloc(nullptr, t_length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p == nullptr)
+        return false;
+#else
+    if (flags & HugePages) {
+        const size_t t_length = alignUp(bytes, HugePageSize);
+        void *p = mmap(nullptr, t_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            mapping.pData  = p;
+            mapping.pBase  = p;
+            mapping.length = t_length;
+            mapping.flags  = HugePages;
+            return true;
+        }
+    }
+
+    const size_t t_length = alignUp(bytes, pageSize());
+    void *p = mmap(nullptr, t_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return false;
+
+    // без зарезервированных страниц hugetlbfs остаётся transparent huge pages
+    if ((flags & HugePages) && (t_length >= HugePageSize))
+        madvise(p, t_length, MADV_HUGEPAGE);
+#endif
+
+    mapping.pData  = p;
+    mapping.pBase  = p;
+    mapping.length = t_length;
+    mapping.flags  = 0;
+
+    return true;
+}
+
+bool RingMemory::mapMirrored(size_t bytes, uint32_t flags, Mapping &mapping) noexcept
+{
+    mapping = Mapping();
+
+#ifdef RINGMEMORY_HAS_MEMFD
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        // первая попытка со страницами 2 МБ, если они запрошены и размер им кратен
+        bool t_huge = false;
+#  ifdef MFD_HUGETLB
+        t_huge = (attempt == 0) && (flags & HugePages) && (bytes % HugePageSize == 0);
+#  endif
+        if ((attempt == 0) && !t_huge)
+            continue;
+
+        const size_t t_align = t_huge ? HugePageSize : pageSize();
+
+        int fd = -1;
+#  ifdef MFD_HUGETLB
+        if (t_huge)
+            fd = memfd_create("colibrinano-ring", MFD_CLOEXEC | MFD_HUGETLB);
+        else
+#  endif
+            fd = memfd_create("colibrinano-ring", MFD_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            ::close(fd);
+            continue;
+        }
+
+        // резервируем 2*bytes адресного пространства и отображаем memfd в обе половины
+        const size_t t_length = 2*bytes + t_align;
+        void *pReserve = mmap(nullptr, t_length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pReserve == MAP_FAILED) {
+            ::close(fd);
+            continue;
+        }
+
+        uint8_t *pBase = reinterpret_cast<uint8_t*>(alignUp(reinterpret_cast<size_t>(pReserve), t_align));
+        void *pFirst  = mmap(pBase        , bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        void *pSecond = mmap(pBase + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        ::close(fd);
+
+        if ((pFirst == MAP_FAILED) || (pSecond == MAP_FAILED)) {
+            munmap(pReserve, t_length);
+            continue;
+        }
+
+        mapping.pData  = pBase;
+        mapping.pBase  = pReserve;
+        mapping.length = t_length;
+        mapping.flags  = t_huge ? (Mirrored | HugePages) : static_cast<uint32_t>(Mirrored);
+
+        return true;
+    }
+#else
+    (void)bytes;
+    (void)flags;
+#endif
+
+    return false;
+}
+
+void RingMemory::unmap(const Mapping &mapping) noexcept
+{
+    if (mapping.pBase == nullptr)
+        return;
+
+#ifndef __linux__
+    VirtualFree(mapping.pBase, 0, MEM_RELEASE);
+#else
+    munmap(mapping.pBase, mapping.length);
+#endif
+}
+
+void RingMemory::finish(size_t bytes, uint32_t flags, Mapping &mapping) noexcept
+{
+    // для зеркальной памяти обрабатываются обе половины отображения
+    uint8_t *pData = static_cast<uint8_t*>(mapping.pData);
+    const size_t t_length = (mapping.flags & Mirrored) ? 2*bytes : bytes;
+
+    if (flags & Locked) {
+#ifndef __linux__
+        if (VirtualLock(pData, t_length))
+            mapping.flags |= Locked;
+#else
+        if (mlock(pData, t_length) == 0)
+            mapping.flags |= Locked;
+#endif
+    }
+
+    // запись в каждую страницу, память новая и уже заполнена нулями
+    if (flags & Prefault) {
+        const size_t t_step = pageSize();
+        for (size_t i = 0; i < t_length; i += t_step)
+            static_cast<volatile uint8_t*>(pData)[i] = 0;
+        mapping.flags |= Prefault;
+    }
+}
+
+}
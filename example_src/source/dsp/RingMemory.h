@@ -0,0 +1,102 @@
+#ifndef RINGMEMORY_H
+#define RINGMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SDR {
+
+/**
+ * \class RingMemory
+ * \brief Память потоковых буферов.
+ *
+ * \details В зеркальном режиме (только Linux) один и тот же memfd отображается
+ * в адресное пространство дважды подряд, поэтому байт data()[i + size()] совпадает
+ * с data()[i]. Любой участок длиной не более size(), начинающийся внутри буфера,
+ * непрерывен в памяти, и кольцевой буфер обходится без разбиения на два сегмента.
+ *
+ * Память всегда выровнена как минимум по строке кэша (64 байта). Дополнительно можно
+ * запросить страницы 2 МБ (HugePages), предварительное обращение ко всем страницам
+ * (Prefault) и запрет выгрузки (Locked), чтобы поток реального времени не получал
+ * page fault после start(). Каждый флаг выполняется, если это возможно в системе,
+ * фактически выполненные флаги возвращает flags().
+ */
+class RingMemory
+{
+public:
+    enum Flag : uint32_t
+    {
+        Mirrored  = 0x01,   ///< двойное отображение (только Linux)
+        HugePages = 0x02,   ///< страницы 2 МБ
+        Prefault  = 0x04,   ///< обращение ко всем страницам при выделении
+        Locked    = 0x08    ///< mlock/VirtualLock
+    };
+
+    static constexpr size_t Alignment = 64;
+    static constexpr size_t HugePageSize = 2*1024*1024;
+
+    RingMemory() = default;
+    ~RingMemory();
+
+    /**
+     * \brief Выделение памяти.
+     * \param bytes - размер в байтах, для зеркального режима кратен pageSize().
+     * \param flags - комбинация флагов Flag.
+     * \return false, если память выделить не удалось.
+     *
+     * \details Если зеркальное отображение недоступно, выделяется обычная память и
+     * isMirrored() возвращает false.
+     */
+    bool allocate(size_t bytes, uint32_t flags);
+
+    /**
+     * \brief Освобождение памяти.
+     */
+    void release() noexcept;
+
+    void    *data() const noexcept       { return m_pData; }
+    size_t   size() const noexcept       { return m_size; }
+    uint32_t flags() const noexcept      { return m_flags; }
+    bool     isMirrored() const noexcept { return (m_flags & Mirrored) != 0; }
+
+    /**
+     * \brief Возвращает размер страницы памяти.
+     */
+    static size_t pageSize() noexcept;
+
+    /**
+     * \brief Выделение отдельного блока памяти с заданными флагами (кроме Mirrored).
+     * \return указатель, выровненный по Alignment, или nullptr.
+     *
+     * \details Используется StreamAllocator для рабочих буферов БПФ и спектра.
+     */
+    static void *allocateBlock(size_t bytes, uint32_t flags) noexcept;
+    static void  releaseBlock(void *pData) noexcept;
+
+private:
+    RingMemory(const RingMemory &) = delete;
+    RingMemory &operator=(const RingMemory &) = delete;
+
+    struct Mapping
+    {
+        void    *pData  { nullptr };
+        void    *pBase  { nullptr };
+        size_t   length { 0 };
+        uint32_t flags  { 0 };
+    };
+
+    static bool map(size_t bytes, uint32_t flags, Mapping &mapping) noexcept;
+    static bool mapMirrored(size_t bytes, uint32_t flags, Mapping &mapping) noexcept;
+    static void unmap(const Mapping &mapping) noexcept;
+    static void finish(size_t bytes, uint32_t flags, Mapping &mapping) noexcept;
+
+private:
+    void    *m_pData { nullptr };
+    size_t   m_size  { 0 };
+    uint32_t m_flags { 0 };
+    Mapping  m_mapping;
+};
+
+}
+
+#endif // RINGMEMORY_H
@@ -0,0 +1,125 @@
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "RingMemory.h"
+#include "spscringbuffer.h"
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \class BlockPool
+ * \brief Набор заранее выделенных буферов, передаваемых между потоками по указателю.
+ *
+ * \details Все буферы находятся в одном выделении RingMemory, каждый выровнен по
+ * строке кэша. Поток-источник получает свободный буфер через acquire(), заполняет
+ * его на месте (например распаковкой USB кадров) и передаёт указатель следующей
+ * ступени через SpscRingBuffer<Buffer*>. Последний владелец возвращает буфер
+ * методом release(). Данные между ступенями не копируются.
+ * acquire() вызывается из одного потока, release() - из одного потока или под
+ * внешней синхронизацией.
+ */
+template <typename T>
+class BlockPool
+{
+    static_assert(is_trivially_copyable<T>::value, "BlockPool requires trivially copyable type");
+
+public:
+    struct Buffer
+    {
+        T        *pData    { nullptr };
+        uint32_t  len      { 0 };       ///< количество записанных элементов
+        uint32_t  capacity { 0 };
+    };
+
+    BlockPool() = default;
+
+    /**
+     * \brief Выделение буферов.
+     * \param blocks - количество буферов.
+     * \param blockSize - размер буфера в элементах.
+     * \param flags - флаги памяти RingMemory::Flag (кроме Mirrored).
+     */
+    bool allocate(uint32_t blocks, uint32_t blockSize, uint32_t flags = RingMemory::Prefault | RingMemory::Locked)
+    {
+        const size_t t_stride = (blockSize*sizeof(T) + RingMemory::Alignment - 1)/RingMemory::Alignment*RingMemory::Alignment;
+
+        m_buffers.clear();
+        m_free.resize(blocks);
+
+        if (!m_memory.allocate(t_stride*blocks, flags & ~RingMemory::Mirrored))
+            return false;
+
+        m_buffers.resize(blocks);
+        uint8_t *pData = static_cast<uint8_t*>(m_memory.data());
+        for (uint32_t i = 0; i < blocks; ++i) {
+            m_buffers[i].pData    = reinterpret_cast<T*>(pData + i*t_stride);
+            m_buffers[i].capacity = blockSize;
+        }
+
+        m_blockSize = blockSize;
+        reset();
+        return true;
+    }
+
+    /**
+     * \brief Возврат всех буферов в пул, только без одновременных acquire()/release().
+     */
+    void reset() noexcept
+    {
+        m_free.clear();
+        for (Buffer &buffer : m_buffers) {
+            Buffer *pBuffer = &buffer;
+            buffer.len = 0;
+            m_free.tryWrite(&pBuffer, 1);
+        }
+    }
+
+    /**
+     * \brief Получение свободного буфера.
+     * \param timeout - максимальное время ожидания, 0 - без ожидания.
+     * \return nullptr, если свободных буферов нет.
+     */
+    Buffer *acquire(chrono::nanoseconds timeout = chrono::nanoseconds::zero()) noexcept
+    {
+        Buffer *pBuffer = nullptr;
+        if (!m_free.tryRead(&pBuffer, 1, timeout))
+            return nullptr;
+
+        pBuffer->len = 0;
+        return pBuffer;
+    }
+
+    /**
+     * \brief Возврат буфера в пул.
+     */
+    void release(Buffer *pBuffer) noexcept
+    {
+        if (pBuffer)
+            m_free.tryWrite(&pBuffer, 1);
+    }
+
+    uint32_t blocks() const noexcept    { return static_cast<uint32_t>(m_buffers.size()); }
+    uint32_t blockSize() const noexcept { return m_blockSize; }
+    uint32_t available() const noexcept { return m_free.available(); }
+
+private:
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+private:
+    RingMemory              m_memory;
+    vector<Buffer>          m_buffers;
+    SpscRingBuffer<Buffer*> m_free;
+    uint32_t                m_blockSize { 0 };
+};
+
+}
+
+#endif // BLOCKPOOL_H
@@ -0,0 +1,289 @@
+#ifndef BROADCASTRINGBUFFER_H
+#define BROADCASTRINGBUFFER_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#include <QtCore>
+#include <QtGlobal>
+
+#include "RingMemory.h"
+#include "Pipeline.h"
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \class BroadcastRingBuffer
+ * \brief Кольцевой буфер потока с одним писателем и несколькими читателями.
+ *
+ * \details Писатель (поток библиотеки, вызывающий callbackRx) копирует поток в буфер
+ * один раз и никогда не ждёт читателей. Каждый читатель (Reader) имеет собственный
+ * курсор и читает поток последовательно. Если читатель отстал больше чем на
+ * capacity() сэмплов, его курсор переносится вперёд на самые старые ещё не
+ * перезаписанные данные, а пропущенные сэмплы учитываются в overruns().
+ * Алгоритм работы: \n
+ *  1) Устанавливается размер буфера;
+ *  2) Читатели создаются объектами Reader, начиная с текущей позиции записи;
+ *  3) Писатель вызывает write();
+ *  4) Каждый читатель вызывает Reader::read() из своего потока.
+ * resize() допускается только при остановленной записи и без читателей.
+ */
+template <typename T>
+class BroadcastRingBuffer
+{
+    static_assert(is_trivially_copyable<T>::value, "BroadcastRingBuffer requires trivially copyable type");
+
+public:
+    /**
+     * \class Reader
+     * \brief Курсор читателя потока.
+     *
+     * \details Объект Reader используется только одним потоком.
+     */
+    class Reader
+    {
+    public:
+        explicit Reader(const BroadcastRingBuffer &buffer) noexcept :
+          m_buffer(buffer),
+          m_index(buffer.m_writeIndex.load(memory_order_acquire)),
+          m_overruns(0),
+          m_maxLag(0)
+        {}
+
+        /**
+         * \brief Последовательное чтение потока.
+         * \param pDst - буфер для данных.
+         * \param len - размер буфера.
+         * \return количество прочитанных сэмплов.
+         */
+        quint32 read(T *pDst, quint32 len) noexcept
+        {
+            return m_buffer.read(*this, pDst, len);
+        }
+
+        /**
+         * \brief Количество сэмплов, доступных для чтения.
+         */
+        quint64 available() const noexcept
+        {
+            return qMin<quint64>(m_buffer.m_writeIndex.load(memory_order_acquire) - m_index, m_buffer.m_capacity);
+        }
+
+        /**
+         * \brief Номер следующего читаемого сэмпла в потоке.
+         */
+        quint64 index() const noexcept      { return m_index; }
+
+        /**
+         * \brief Количество сэмплов, пропущенных из-за отставания читателя.
+         */
+        quint64 overruns() const noexcept   { return m_overruns; }
+
+        /**
+         * \brief Максимальное отставание читателя от писателя в сэмплах.
+         */
+        quint64 maxLag() const noexcept     { return m_maxLag; }
+
+    private:
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        friend class BroadcastRingBuffer;
+
+        const BroadcastRingBuffer &m_buffer;
+        quint64 m_index;
+        quint64 m_overruns;
+        quint64 m_maxLag;
+    };
+
+    /**
+     * \brief Конструктор.
+     * \param t_size - размер буфера, округляется до степени двойки.
+     * \param flags - флаги памяти RingMemory::Flag.
+     */
+    explicit BroadcastRingBuffer(quint32 t_size = 0, quint32 flags = RingMemory::Mirrored) :
+      m_capacity(0),
+      m_mask(0),
+      m_reserveIndex(0),
+      m_writeIndex(0),
+      m_pBuffer(nullptr)
+    {
+        resize(t_size, flags);
+    }
+
+    /**
+     * \brief Установка размера буфера.
+     * \param t_size - размер буфера, округляется до степени двойки.
+     * \param flags - флаги памяти RingMemory::Flag.
+     */
+    void resize(quint32 t_size, quint32 flags = RingMemory::Mirrored)
+    {
+        quint32 t_capacity = 1;
+        while (t_capacity < t_size)
+            t_capacity <<= 1;
+        if (t_size == 0u)
+            t_capacity = 0;
+
+        // зеркальная память делает каждое чтение и запись одним memcpy
+        if (!m_memory.allocate(t_capacity*sizeof(T), flags))
+            t_capacity = 0;
+
+        m_pBuffer  = static_cast<T*>(m_memory.data());
+        m_capacity = t_capacity;
+        m_mask     = t_capacity ? t_capacity - 1 : 0;
+        m_reserveIndex.store(0, memory_order_relaxed);
+        m_writeIndex.store(0, memory_order_relaxed);
+    }
+
+    quint32 capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    /**
+     * \brief Возвращает фактически выполненные флаги памяти.
+     */
+    quint32 memoryFlags() const noexcept
+    {
+        return m_memory.flags();
+    }
+
+    /**
+     * \brief Номер следующего записываемого сэмпла в потоке.
+     */
+    quint64 writeIndex() const noexcept
+    {
+        return m_writeIndex.load(memory_order_acquire);
+    }
+
+    /**
+     * \brief Запись в буфер.
+     *
+     * \details Из блока длиннее capacity() сохраняются последние capacity() сэмплов.
+     */
+    bool write(const T *pSrc, quint32 len) noexcept
+    {
+        if ((len == 0u) || (m_capacity == 0u))
+            return false;
+
+        const quint64 t_write = m_writeIndex.load(memory_order_relaxed);
+        const quint32 t_len   = qMin(len, m_capacity);
+        const quint64 t_begin = t_write + len - t_len;
+        pSrc += len - t_len;
+
+        // читатели проверяют m_reserveIndex после копирования, чтобы обнаружить перезапись
+        m_reserveIndex.store(t_write + len, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        copyTo(t_begin, pSrc, t_len);
+
+        m_writeIndex.store(t_write + len, memory_order_release);
+        return true;
+    }
+
+private:
+    BroadcastRingBuffer(const BroadcastRingBuffer &) = delete;
+    BroadcastRingBuffer &operator=(const BroadcastRingBuffer &) = delete;
+
+    quint32 read(Reader &reader, T *pDst, quint32 len) const noexcept
+    {
+        while (true) {
+            const quint64 t_write = m_writeIndex.load(memory_order_acquire);
+            const quint64 t_lag   = t_write - reader.m_index;
+            reader.m_maxLag = qMax(reader.m_maxLag, t_lag);
+
+            // отставший читатель переносится на самые старые доступные данные
+            if (t_lag > m_capacity) {
+                reader.m_overruns += t_lag - m_capacity;
+                reader.m_index     = t_write - m_capacity;
+            }
+
+            const quint32 t_len = static_cast<quint32>(qMin<quint64>(len, t_write - reader.m_index));
+            if (t_len == 0u)
+                return 0;
+
+            copyFrom(reader.m_index, pDst, t_len);
+
+            // если писатель успел перезаписать прочитанное, данные читаются заново
+            atomic_thread_fence(memory_order_acquire);
+            if (m_reserveIndex.load(memory_order_relaxed) - reader.m_index <= m_capacity) {
+                reader.m_index += t_len;
+                return t_len;
+            }
+        }
+    }
+
+    void copyTo(quint64 index, const T *pSrc, quint32 len) noexcept
+    {
+        const quint32 t_offset = static_cast<quint32>(index & m_mask);
+        const quint32 t_first  = m_memory.isMirrored() ? len : qMin(len, m_capacity - t_offset);
+        memcpy(m_pBuffer + t_offset, pSrc, t_first*sizeof(T));
+        if (t_first < len)
+            memcpy(m_pBuffer, pSrc + t_first, (len - t_first)*sizeof(T));
+    }
+
+    void copyFrom(quint64 index, T *pDst, quint32 len) const noexcept
+    {
+        const quint32 t_offset = static_cast<quint32>(index & m_mask);
+        const quint32 t_first  = m_memory.isMirrored() ? len : qMin(len, m_capacity - t_offset);
+        memcpy(pDst, m_pBuffer + t_offset, t_first*sizeof(T));
+        if (t_first < len)
+            memcpy(pDst + t_first, m_pBuffer, (len - t_first)*sizeof(T));
+    }
+
+private:
+    quint32 m_capacity;
+    quint32 m_mask;
+
+    atomic<quint64> m_reserveIndex;
+    atomic<quint64> m_writeIndex;
+
+    RingMemory m_memory;
+    T         *m_pBuffer;
+};
+
+
+/**
+ * \class BroadcastStage
+ * \brief Ступень Pipeline, раздающая входной поток читателям BroadcastRingBuffer.
+ *
+ * \details Буфер выделяется при создании ступени, то есть только когда появился
+ * потребитель, и пишется рабочим потоком Pipeline, а не потоком callbackRx.
+ * Все читатели читают одну копию потока.
+ */
+class BroadcastStage : public PipelineStage
+{
+public:
+    /**
+     * \brief Конструктор.
+     * \param t_size - размер буфера, округляется до степени двойки.
+     * \param flags - флаги памяти RingMemory::Flag.
+     */
+    explicit BroadcastStage(quint32 t_size, quint32 flags = RingMemory::Mirrored) :
+      PipelineStage({ PortType::Complex }, PortType::None),
+      m_buffer(t_size, flags)
+    {}
+
+    const BroadcastRingBuffer<Complex> &buffer() const noexcept
+    {
+        return m_buffer;
+    }
+
+protected:
+    Block process(const Block *pInputs, uint32_t count) override
+    {
+        if ((count > 0u) && pInputs[0].complex())
+            m_buffer.write(pInputs[0].complex(), pInputs[0].len);
+        return Block();
+    }
+
+private:
+    BroadcastRingBuffer<Complex> m_buffer;
+};
+
+}
+
+#endif // BROADCASTRINGBUFFER_H
@@ -65,15 +65,20 @@ public:
 
     bool process(vector<Complex> &srcDst, bool fwd) noexcept
     {
-        if ((srcDst.size() != m_size) || (m_size == 0))
+        return process(srcDst.data(), static_cast<uint32_t>(srcDst.size()), fwd);
+    }
+
+    bool process(Complex *srcDst, uint32_t len, bool fwd) noexcept
+    {
+        if ((len != m_size) || (m_size == 0))
             return false;
 
         if (fwd) {
             forward(srcDst);
 
-            for (auto &sample : srcDst) {
-                sample.re *= m_k;
-                sample.im *= m_k;
+            for (uint32_t i = 0; i < len; ++i) {
+                srcDst[i].re *= m_k;
+                srcDst[i].im *= m_k;
             }
         }
         else {
@@ -101,7 +106,7 @@ private:
         }
     }
 
-    void forward(vector<Complex> &srcDst) noexcept
+    void forward(Complex *srcDst) noexcept
     {
         uint32_t i, j, k, io, ie, in, nn;
         Real ru, iu, rtp, itp, rtq, itq, rw, iw, sr;
@@ -156,7 +161,7 @@ private:
          }
     }
 
-    void backward(vector<Complex> &srcDst) noexcept
+    void backward(Complex *srcDst) noexcept
     {
         uint32_t i, j, n, k, io, ie, in, nn;
         Real ru, iu, rtp, itp, rtq, itq, rw, iw, sr;
@@ -4,15 +4,106 @@
 #define SPECTRUMRINGBUFFER_H
 
 #include <atomic>
+#include <cstring>
+#include <type_traits>
 #include <vector>
 
 #include <QtCore>
 #include <QtGlobal>
 
+#include "RingMemory.h"
+
 namespace SDR {
 
 using namespace std;
 
+/**
+ * \brief Память SpectrumRingBuffer с размером, заданным при компиляции.
+ *
+ * \details N - размер чтения, степень двойки. Память 2*N сэмплов находится внутри
+ * объекта и выровнена по строке кэша, размеры и маска являются константами.
+ */
+template <typename T, quint32 N>
+class SpectrumRingStorage
+{
+    static_assert((N & (N - 1)) == 0, "SpectrumRingBuffer size must be a power of two");
+
+public:
+    static constexpr quint32 size() noexcept     { return N; }
+    static constexpr quint32 capacity() noexcept { return 2*N; }
+    static constexpr quint32 mask() noexcept     { return 2*N - 1; }
+    static constexpr bool isMirrored() noexcept  { return false; }
+
+    T *data() noexcept { return m_buffer; }
+
+    quint32 flags() const noexcept { return 0; }
+
+    void allocate(quint32, quint32) noexcept {}
+
+private:
+    alignas(64) T m_buffer[2*N];
+};
+
+/**
+ * \brief Память SpectrumRingBuffer с размером, заданным во время работы.
+ */
+template <typename T>
+class SpectrumRingStorage<T, 0>
+{
+public:
+    quint32 size() const noexcept     { return m_size; }
+    quint32 capacity() const noexcept { return m_capacity; }
+    quint32 mask() const noexcept     { return m_mask; }
+    bool isMirrored() const noexcept  { return m_memory.isMirrored(); }
+    quint32 flags() const noexcept    { return m_memory.flags(); }
+
+    T *data() noexcept { return m_pBuffer; }
+
+    void allocate(quint32 t_size, quint32 flags)
+    {
+        const bool mirrored = (flags & RingMemory::Mirrored) != 0;
+
+        t_size = t_size ? pow2Next(t_size) : 0;
+
+        // память в два раза больше размера чтения, в зеркальном режиме не меньше страницы
+        quint32 t_capacity = 2*t_size;
+        if (mirrored && t_capacity)
+            t_capacity = qMax<quint32>(t_capacity, pow2Next(static_cast<quint32>(RingMemory::pageSize()/sizeof(T))));
+
+        if (!m_memory.allocate(sizeof(T)*t_capacity, flags)) {
+            t_size     = 0;
+            t_capacity = 0;
+        }
+
+        m_pBuffer  = static_cast<T*>(m_memory.data());
+        m_size     = t_size;
+        m_capacity = t_capacity;
+        m_mask     = t_capacity ? t_capacity - 1 : 0;
+    }
+
+private:
+    static quint32 pow2Next(quint32 d) noexcept
+    {
+        d--;
+        d |= d >> 1;
+        d |= d >> 2;
+        d |= d >> 4;
+        d |= d >> 8;
+        d |= d >> 16;
+        d++;
+        return d;
+    }
+
+private:
+    quint32 m_size     { 0 };
+    quint32 m_capacity { 0 };
+    quint32 m_mask     { 0 };
+
+    RingMemory m_memory;
+    T         *m_pBuffer { nullptr };
+};
+
+
 /**
  * \class SpectrumRingBuffer
  * \brief Кольцевой буфер для вычисления спектра.
@@ -27,11 +118,49 @@ using namespace std;
  *  3) Как только количество записанных сэмплов становится равным или большим размера буфера разрешается чтение;
  *  4) Как только был прочитан весь буфер включается запрет на чтение;
  *  5) После прихода порции новых сэмплов снова разрешается чтение всего буфера.
+ *
+ * Буфер рассчитан на одного писателя (поток библиотеки, вызывающий callbackRx) и одного
+ * читателя и не использует блокировок. Запись никогда не ждёт читателя: индекс записи
+ * публикуется с memory_order_release, данные копируются не более чем двумя memcpy.
+ * Чтение без копирования выполняется через acquireRead()/releaseRead(): читатель получает
+ * до двух непрерывных участков памяти буфера, которые закреплены до releaseRead().
+ * Память буфера в два раза больше размера чтения, поэтому писатель может продвинуться
+ * на size() сэмплов, пока данные закреплены. Блок, который перезаписал бы закреплённые
+ * данные, отбрасывается писателем, а не ожидает читателя.
+ * Каждый записанный сэмпл имеет 64-битный порядковый номер, который возвращается при
+ * чтении. Отброшенные блоки занимают номера, поэтому разрыв потока между двумя
+ * чтениями определяется точно по номерам. Сэмплы между двумя чтениями делятся на
+ * перезаписанные до чтения (overwritten(), читатель не успел) и пропущенные
+ * читателем намеренно, когда он берёт последние данные (skipped()); вместе с
+ * прочитанными они покрывают все номера. Отброшенные писателем блоки дополнительно
+ * учитываются в dropped().
+ * В зеркальном режиме (setMirrored(), только Linux) память отображается дважды подряд,
+ * и закреплённые данные всегда составляют один непрерывный участок.
+ * resize(), setMirrored(), setMemoryFlags() и fill() допускаются только при остановленной записи.
+ *
+ * SpectrumRingBuffer<T, N> с N, равным степени двойки, имеет размер, заданный при
+ * компиляции: память встроена в объект и выровнена по строке кэша, resize() и
+ * setMirrored() недоступны. Индексы писателя и читателя в обоих вариантах находятся
+ * на разных строках кэша, чтобы поток библиотеки и поток чтения не делили строку.
  */
-template <typename T>
+template <typename T, quint32 N = 0>
 class SpectrumRingBuffer
 {
+    static_assert(is_trivially_copyable<T>::value, "SpectrumRingBuffer requires trivially copyable type");
+
 public:
+    /**
+     * \brief Закреплённые для чтения данные: участок до и после конца памяти буфера.
+     */
+    struct ReadSpan
+    {
+        const T *pData[2] { nullptr, nullptr };
+        quint32  len[2]   { 0, 0 };
+        quint64  index    { 0 };        ///< порядковый номер первого сэмпла
+
+        quint32 size() const noexcept { return len[0] + len[1]; }
+    };
+
     /**
      * \brief Конструктор класса по умолчанию.
      * \param t_size - размер буфера.
@@ -54,11 +183,36 @@ public:
      */
     quint32 size() const noexcept;
 
+    /**
+     * \brief Возвращает размер памяти буфера в сэмплах.
+     */
+    quint32 capacity() const noexcept;
+
+    /**
+     * \brief Включение зеркального отображения памяти.
+     * \param state - статус.
+     * \return true, если зеркальный режим действует.
+     *
+     * \details Если зеркальное отображение недоступно, буфер продолжает работать
+     * с обычной памятью и двумя участками чтения.
+     */
+    bool setMirrored(bool state);
+    bool isMirrored() const noexcept;
+
+    /**
+     * \brief Установка флагов памяти буфера (RingMemory::Flag).
+     * \param flags - зеркальное отображение, страницы 2 МБ, предварительное обращение, mlock.
+     * \return фактически выполненные флаги.
+     */
+    quint32 setMemoryFlags(quint32 flags);
+    quint32 memoryFlags() const noexcept;
+
 
     /**
      * \brief Очистка буфера.
      *
      * \details Содержимое буфера не обнуляется, это не требуется.
+     * Вызывается читателем, чтение снова станет доступно после записи size() сэмплов.
      */
     void clear() noexcept;
 
@@ -85,10 +239,65 @@ public:
     /**
      * \brief Чтение содержимого всего буфера.
      * \param dst - буфер в который запишутся данные.
+     * \param pIndex - порядковый номер первого прочитанного сэмпла.
+     * \return статус выполнения.
+     */
+    bool readAll(vector<T> &dst, quint64 *pIndex = nullptr) noexcept;
+    bool readAll(T *pDst, quint32 len, quint64 *pIndex = nullptr) noexcept;
+
+    /**
+     * \brief Чтение содержимого всего буфера без копирования.
+     * \param span - участки памяти буфера с последними size() сэмплами.
      * \return статус выполнения.
+     *
+     * \details При успешном выполнении данные закреплены до вызова releaseRead(),
+     * писатель их не перезаписывает. Закрепление следует снимать как можно быстрее:
+     * пока оно действует, в буфер помещается не более size() новых сэмплов.
+     */
+    bool acquireRead(ReadSpan &span) noexcept;
+
+    /**
+     * \brief Закрепление последних len сэмплов, len не больше capacity()/2.
+     *
+     * \details Позволяет читать окна длиннее size(), например для БПФ с перекрытием.
+     */
+    bool acquireRead(ReadSpan &span, quint32 len) noexcept;
+
+    /**
+     * \brief Снятие закрепления, установленного acquireRead().
+     */
+    void releaseRead() noexcept;
+
+    /**
+     * \brief Возвращает количество сэмплов, отброшенных писателем из-за закрепления.
+     */
+    quint64 dropped() const noexcept;
+
+    /**
+     * \brief Возвращает порядковый номер следующего записываемого сэмпла.
+     */
+    quint64 writeIndex() const noexcept;
+
+    /**
+     * \brief Возвращает количество сэмплов, перезаписанных до того, как их можно было прочитать.
+     *
+     * \details Сэмплы между концом предыдущего чтения и началом самых старых данных,
+     * оставшихся в памяти буфера к следующему чтению: переполнение из-за медленного читателя.
+     */
+    quint64 overwritten() const noexcept;
+
+    /**
+     * \brief Возвращает количество сэмплов, пропущенных читателем намеренно.
+     *
+     * \details Сэмплы, которые ещё были в памяти буфера, но не вошли в чтение,
+     * потому что читатель берёт последние size() (или len) сэмплов.
      */
-    bool readAll(vector<T> &dst) noexcept;
-    bool readAll(T *pDst, quint32 len) noexcept;
+    quint64 skipped() const noexcept;
+
+    /**
+     * \brief Возвращает количество попыток чтения, когда новых данных не было.
+     */
+    quint64 underruns() const noexcept;
 
     /**
      * \brief Запись в буфер.
@@ -107,205 +316,321 @@ private:
     SpectrumRingBuffer(const SpectrumRingBuffer &) = delete;
     SpectrumRingBuffer &operator=(const SpectrumRingBuffer &) = delete;
 
-    inline int pow2Next(int d)
-    {
-        d--;
-        d |= d >> 1;
-        d |= d >> 2;
-        d |= d >> 4;
-        d |= d >> 8;
-        d |= d >> 16;
-        d++;
-        return d;
-    }
+    void reset() noexcept;
 
 private:
-    quint32 m_size;
-    quint32 m_readPtr;
-    quint32 m_writePtr;
-    quint32 m_mask;
-
-    atomic_bool      m_readyRead;
-    atomic<quint32> m_bytesForRead;
-    atomic<quint32> m_bytesForWrite;
-
-    vector<T> m_buffer;
-    QMutex     m_mutex;
+    static constexpr quint64 NoPin = ~quint64(0);
+
+    SpectrumRingStorage<T, N> m_storage;
+    quint32 m_flags;
+
+    // индексы монотонно растут, изменяются только писателем:
+    // m_reserveIndex - конец записываемых данных, m_writeIndex - конец опубликованных
+    alignas(64) atomic<quint64> m_reserveIndex;
+    atomic<quint64> m_writeIndex;
+    atomic<quint64> m_dropped;
+    atomic<quint64> m_gapEnd;           // конец последнего отброшенного блока
+
+    // начало закреплённых читателем данных или NoPin
+    alignas(64) atomic<quint64> m_pinIndex;
+
+    // изменяются только читателем
+    quint64 m_readIndex;
+    quint64 m_fillIndex;
+    atomic<quint64> m_overwritten;
+    atomic<quint64> m_skipped;
+    atomic<quint64> m_underruns;
 };
 
 
-template <typename T>
-SpectrumRingBuffer<T>::SpectrumRingBuffer(quint32 t_size) :
-  m_size(t_size),
-  m_readPtr(0),
-  m_writePtr(0),
-  m_mask(0),
-  m_readyRead(false),
-  m_bytesForRead(0),
-  m_bytesForWrite(0)
+template <typename T, quint32 N>
+SpectrumRingBuffer<T, N>::SpectrumRingBuffer(quint32 t_size) :
+  m_flags(0),
+  m_reserveIndex(0),
+  m_writeIndex(0),
+  m_dropped(0),
+  m_gapEnd(0),
+  m_pinIndex(NoPin),
+  m_readIndex(0),
+  m_fillIndex(0),
+  m_overwritten(0),
+  m_skipped(0),
+  m_underruns(0)
 {
-    // установка размера буфера
-    m_buffer.resize(pow2Next(t_size));
+    // размер SpectrumRingBuffer<T, N> задан при компиляции
+    m_storage.allocate(t_size, m_flags);
+}
 
-    // инициализация
-    m_size = m_buffer.size();
-    m_mask = m_size - 1;
-    m_bytesForWrite = m_size;
+template <typename T, quint32 N>
+void SpectrumRingBuffer<T, N>::resize(quint32 t_size)
+{
+    static_assert(N == 0, "SpectrumRingBuffer with compile-time size cannot be resized");
 
+    if ((m_storage.size() == t_size) && m_storage.data())
+        return;
+
+    m_storage.allocate(t_size, m_flags);
+    reset();
 }
 
-template <typename T>
-void SpectrumRingBuffer<T>::resize(quint32 t_size)
+template <typename T, quint32 N>
+void SpectrumRingBuffer<T, N>::reset() noexcept
 {
-    if (m_size == t_size)
-        return;
+    m_reserveIndex.store(0, memory_order_relaxed);
+    m_writeIndex.store(0, memory_order_relaxed);
+    m_gapEnd.store(0, memory_order_relaxed);
+    m_readIndex = 0;
+    m_fillIndex = 0;
+
+    // счётчики относятся к нумерации сэмплов, которая начинается заново
+    m_dropped.store(0, memory_order_relaxed);
+    m_overwritten.store(0, memory_order_relaxed);
+    m_skipped.store(0, memory_order_relaxed);
+    m_underruns.store(0, memory_order_relaxed);
+}
 
-    // запрещаем запись и чтение
-    m_bytesForRead  = 0;
-    m_bytesForWrite = 0;
+template <typename T, quint32 N>
+quint32 SpectrumRingBuffer<T, N>::size() const noexcept
+{
+    return m_storage.size();
+}
 
-    // установка размера буфера
-    m_mutex.lock();
-        m_buffer.resize(pow2Next(t_size));
-    m_mutex.unlock();
+template <typename T, quint32 N>
+quint32 SpectrumRingBuffer<T, N>::capacity() const noexcept
+{
+    return m_storage.capacity();
+}
 
-    // инициализация
-    m_size = m_buffer.size();
-    m_mask = m_size - 1;
-    m_bytesForWrite = m_size;
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::setMirrored(bool state)
+{
+    setMemoryFlags(state ? m_flags | RingMemory::Mirrored : m_flags & ~RingMemory::Mirrored);
+    return m_storage.isMirrored();
 }
 
-template <typename T>
-quint32 SpectrumRingBuffer<T>::size() const noexcept
+template <typename T, quint32 N>
+quint32 SpectrumRingBuffer<T, N>::setMemoryFlags(quint32 flags)
 {
-    return m_size;
+    static_assert(N == 0, "SpectrumRingBuffer with compile-time size has fixed memory");
+
+    if (m_flags != flags) {
+        m_flags = flags;
+        if (m_storage.size()) {
+            m_storage.allocate(m_storage.size(), m_flags);
+            reset();
+        }
+    }
+
+    return m_storage.flags();
 }
 
-template <typename T>
-void SpectrumRingBuffer<T>::clear() noexcept
+template <typename T, quint32 N>
+quint32 SpectrumRingBuffer<T, N>::memoryFlags() const noexcept
 {
-    // запрещаем запись и чтение
-    m_bytesForRead  = 0;
-    m_bytesForWrite = 0;
+    return m_storage.flags();
+}
 
-    // сбрасываем указатели записи и чтения
-    m_readPtr  = 0;
-    m_writePtr = 0;
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::isMirrored() const noexcept
+{
+    return m_storage.isMirrored();
+}
 
-    // сбрасываем флаг, который разрешает чтение
-    m_readyRead = false;
+template <typename T, quint32 N>
+void SpectrumRingBuffer<T, N>::clear() noexcept
+{
+    // чтение будет разрешено после записи m_storage.size() новых сэмплов
+    m_fillIndex = m_writeIndex.load(memory_order_acquire);
+    m_readIndex = m_fillIndex;
+}
 
-    // разрешаем запись и чтение
-    m_bytesForWrite = m_size;
+template <typename T, quint32 N>
+void SpectrumRingBuffer<T, N>::fill(T value)
+{
+    std::fill(m_storage.data(), m_storage.data() + m_storage.capacity(), value);
 }
 
-template <typename T>
-void SpectrumRingBuffer<T>::fill(T value)
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::readyRead() const noexcept
 {
-    m_mutex.lock();
-        m_buffer.fill(value);
-    m_mutex.unlock();
+    const quint64 t_write = m_writeIndex.load(memory_order_acquire);
+    return (m_storage.size() != 0u) && (t_write - m_fillIndex >= m_storage.size()) && (t_write != m_readIndex);
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::readyRead() const noexcept
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::readyWrite() const noexcept
 {
-    return m_readyRead;
+    return m_storage.size() != 0;
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::readyWrite() const noexcept
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::readAll(vector<T> & dst, quint64 *pIndex) noexcept
 {
-    return m_size != 0;
+    // проверяем доступность чтения
+    if (static_cast<quint32>(dst.size()) != m_storage.size())
+        return false;
+
+    return readAll(dst.data(), m_storage.size(), pIndex);
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::readAll(vector<T> & dst) noexcept
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::readAll(T *pDst, quint32 len, quint64 *pIndex) noexcept
 {
     // проверяем доступность чтения
-    if ((static_cast<quint32>(dst.size()) != m_size) || !m_readyRead)
+    if (len != m_storage.size())
         return false;
 
-    // перед началом чтения сбрасываем флаг, определяющий доступность чтения
-    m_readyRead = false;
+    ReadSpan t_span;
+    if (!acquireRead(t_span))
+        return false;
 
     // чтение данных
-    m_mutex.lock();
-        // устанавливаем указатель на начало данных
-        m_readPtr   = m_writePtr;
+    memcpy(pDst, t_span.pData[0], t_span.len[0]*sizeof(T));
+    if (t_span.len[1])
+        memcpy(pDst + t_span.len[0], t_span.pData[1], t_span.len[1]*sizeof(T));
+
+    releaseRead();
 
-        for (T &data : dst)
-            data = m_buffer[m_readPtr++&m_mask];
-    m_mutex.unlock();
+    if (pIndex)
+        *pIndex = t_span.index;
 
     // успешное выполнение
     return true;
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::readAll(T *pDst, quint32 len) noexcept
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::acquireRead(ReadSpan &span) noexcept
+{
+    return acquireRead(span, m_storage.size());
+}
+
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::acquireRead(ReadSpan &span, quint32 len) noexcept
 {
+    if ((len == 0u) || (len > m_storage.capacity()/2))
+        return false;
+
     // проверяем доступность чтения
-    if ((len != m_size) || !m_readyRead)
+    const quint64 t_write = m_writeIndex.load(memory_order_acquire);
+    if (!readyRead() || (t_write - m_fillIndex < len)) {
+        m_underruns.fetch_add(1, memory_order_relaxed);
         return false;
+    }
 
-    // перед началом чтения сбрасываем флаг, определяющий доступность чтения
-    m_readyRead = false;
+    const quint64 t_begin = t_write - len;
 
-    // чтение данных
-    m_mutex.lock();
-        // устанавливаем указатель на начало данных
-        m_readPtr   = m_writePtr;
+    // закрепляем данные и проверяем, что писатель не начал их перезаписывать
+    m_pinIndex.store(t_begin, memory_order_seq_cst);
+    if (m_reserveIndex.load(memory_order_seq_cst) - t_begin > m_storage.capacity()) {
+        m_pinIndex.store(NoPin, memory_order_release);
+        return false;
+    }
 
-        for (quint32 i = 0; i < len; ++i)
-            pDst[i] = m_buffer[m_readPtr++&m_mask];
-    m_mutex.unlock();
+    // в окно попал отброшенный блок, его память содержит старые данные
+    if (m_gapEnd.load(memory_order_relaxed) > t_begin) {
+        m_pinIndex.store(NoPin, memory_order_release);
+        return false;
+    }
+
+    const quint32 t_offset = static_cast<quint32>(t_begin & m_storage.mask());
+    const quint32 t_first  = m_storage.isMirrored() ? len : qMin(len, m_storage.capacity() - t_offset);
+    span.pData[0] = m_storage.data() + t_offset;
+    span.len[0]   = t_first;
+    span.pData[1] = m_storage.data();
+    span.len[1]   = len - t_first;
+    span.index    = t_begin;
+
+    // сэмплы между предыдущим и текущим чтением: старше памяти буфера - перезаписаны,
+    // остальные читатель пропустил сам, взяв последние данные
+    if (t_begin > m_readIndex) {
+        const quint64 t_oldest = t_write > m_storage.capacity() ? t_write - m_storage.capacity() : 0;
+        const quint64 t_lost   = t_oldest > m_readIndex ? qMin(t_oldest, t_begin) - m_readIndex : 0;
+        m_overwritten.fetch_add(t_lost, memory_order_relaxed);
+        m_skipped.fetch_add(t_begin - m_readIndex - t_lost, memory_order_relaxed);
+    }
+    m_readIndex = t_write;
 
-    // успешное выполнение
     return true;
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::write(const vector<T> & src) noexcept
+template <typename T, quint32 N>
+void SpectrumRingBuffer<T, N>::releaseRead() noexcept
 {
-    // проверяем доступность записи
-    if ((src.size() == 0) && (m_size == 0u))
-        return false;
+    m_pinIndex.store(NoPin, memory_order_release);
+}
 
-    // запись данных
-    m_mutex.lock();
-        for (T &data : const_cast<vector<T> &>(src))
-            m_buffer[m_writePtr++&m_mask] = data;
-        m_writePtr &= m_mask;
-    m_mutex.unlock();
+template <typename T, quint32 N>
+quint64 SpectrumRingBuffer<T, N>::dropped() const noexcept
+{
+    return m_dropped.load(memory_order_relaxed);
+}
 
-    // определяем количество доступных для чтения сэмплов
-    m_bytesForRead = qMin<quint32>(m_bytesForRead + src.size(), m_size);
-    //устанавливаем флаг, определяющий доступность чтения
-    m_readyRead    = m_bytesForRead == m_size;
+template <typename T, quint32 N>
+quint64 SpectrumRingBuffer<T, N>::writeIndex() const noexcept
+{
+    return m_writeIndex.load(memory_order_acquire);
+}
 
-    // успешное выполнение
-    return true;
+template <typename T, quint32 N>
+quint64 SpectrumRingBuffer<T, N>::overwritten() const noexcept
+{
+    return m_overwritten.load(memory_order_relaxed);
 }
 
-template <typename T>
-bool SpectrumRingBuffer<T>::write(const T *pSrc, quint32 len) noexcept
+template <typename T, quint32 N>
+quint64 SpectrumRingBuffer<T, N>::skipped() const noexcept
+{
+    return m_skipped.load(memory_order_relaxed);
+}
+
+template <typename T, quint32 N>
+quint64 SpectrumRingBuffer<T, N>::underruns() const noexcept
+{
+    return m_underruns.load(memory_order_relaxed);
+}
+
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::write(const vector<T> & src) noexcept
+{
+    return write(src.data(), static_cast<quint32>(src.size()));
+}
+
+template <typename T, quint32 N>
+bool SpectrumRingBuffer<T, N>::write(const T *pSrc, quint32 len) noexcept
 {
     // проверяем доступность записи
-    if ((len == 0u) && (m_size == 0u))
+    if ((len == 0u) || (m_storage.size() == 0u))
         return false;
 
-    // запись данных
-    m_mutex.lock();
-        for (quint32 i = 0; i < len; ++i)
-            m_buffer[m_writePtr++&m_mask] = pSrc[i];
-        m_writePtr &= m_mask;
-    m_mutex.unlock();
-
-    // определяем количество доступных для чтения сэмплов
-    m_bytesForRead = qMin<quint32>(m_bytesForRead + len, m_size);
-    //устанавливаем флаг, определяющий доступность чтения
-    m_readyRead    = m_bytesForRead == m_size;
+    const quint64 t_write = m_writeIndex.load(memory_order_relaxed);
+
+    // из длинного блока сохраняются только последние capacity() сэмплов
+    const quint32 t_len = qMin(len, m_storage.capacity());
+    const quint64 t_begin = t_write + len - t_len;
+    pSrc += len - t_len;
+
+    // сообщаем читателю о начале записи до изменения данных
+    m_reserveIndex.store(t_write + len, memory_order_seq_cst);
+
+    // блок не должен перезаписать закреплённые читателем данные,
+    // отброшенный блок занимает порядковые номера, но не записывается
+    const quint64 t_pin = m_pinIndex.load(memory_order_seq_cst);
+    if ((t_pin != NoPin) && (t_write + len - t_pin > m_storage.capacity())) {
+        m_dropped.fetch_add(len, memory_order_relaxed);
+        m_gapEnd.store(t_write + len, memory_order_relaxed);
+        m_writeIndex.store(t_write + len, memory_order_release);
+        return false;
+    }
+
+    // запись данных не более чем двумя сегментами
+    const quint32 t_offset = static_cast<quint32>(t_begin & m_storage.mask());
+    const quint32 t_first  = m_storage.isMirrored() ? t_len : qMin(t_len, m_storage.capacity() - t_offset);
+    memcpy(m_storage.data() + t_offset, pSrc, t_first*sizeof(T));
+    if (t_first < t_len)
+        memcpy(m_storage.data(), pSrc + t_first, (t_len - t_first)*sizeof(T));
+
+    // публикуем данные
+    m_writeIndex.store(t_write + len, memory_order_release);
 
     // успешное выполнение
     return true;
@@ -0,0 +1,180 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "AdaptiveWait.h"
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \class SpscRingBuffer
+ * \brief Очередь без блокировок с одним писателем и одним читателем.
+ *
+ * \details Данные передаются указателем и длиной и копируются один раз, запись и
+ * чтение выполняются целиком или не выполняются. Если места (данных) нет,
+ * tryWrite()/tryRead() ждут не дольше timeout: сначала активно, затем в ядре
+ * (AdaptiveWait), пробуждение выполняет противоположная сторона только при наличии
+ * спящего потока. Индексы писателя и читателя находятся в разных строках кэша.
+ * Читателей (писателей) может быть несколько, если их вызовы упорядочены внешней
+ * синхронизацией, например мьютексом.
+ * highWater() возвращает наибольшее заполнение, зафиксированное писателем после
+ * записи, по нему выбирается размер буфера.
+ * resize() и clear() допускаются только без одновременных записи и чтения.
+ */
+template <typename T>
+class SpscRingBuffer
+{
+    static_assert(is_trivially_copyable<T>::value, "SpscRingBuffer requires trivially copyable type");
+
+public:
+    explicit SpscRingBuffer(uint32_t t_size = 0)
+    {
+        resize(t_size);
+    }
+
+    /**
+     * \brief Установка размера буфера.
+     * \param t_size - размер, округляется до степени двойки.
+     */
+    void resize(uint32_t t_size)
+    {
+        uint32_t t_capacity = 1;
+        while (t_capacity < t_size)
+            t_capacity <<= 1;
+
+        m_buffer.assign(t_size ? t_capacity : 0, T());
+        m_mask = t_size ? t_capacity - 1 : 0;
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        m_writeIndex.store(0, memory_order_relaxed);
+        m_readIndex.store(0, memory_order_relaxed);
+        m_highWater.store(0, memory_order_relaxed);
+    }
+
+    uint32_t capacity() const noexcept
+    {
+        return static_cast<uint32_t>(m_buffer.size());
+    }
+
+    /**
+     * \brief Количество элементов, доступных для чтения.
+     */
+    uint32_t available() const noexcept
+    {
+        return m_writeIndex.load(memory_order_acquire) - m_readIndex.load(memory_order_acquire);
+    }
+
+    /**
+     * \brief Наибольшее количество элементов в буфере после clear().
+     */
+    uint32_t highWater() const noexcept
+    {
+        return m_highWater.load(memory_order_relaxed);
+    }
+
+    /**
+     * \brief Количество свободных элементов.
+     */
+    uint32_t space() const noexcept
+    {
+        return capacity() - available();
+    }
+
+    /**
+     * \brief Запись блока.
+     * \param pSrc - данные.
+     * \param len - размер блока.
+     * \param timeout - максимальное время ожидания свободного места, 0 - без ожидания.
+     * \return false, если места не появилось.
+     */
+    bool tryWrite(const T *pSrc, uint32_t len, chrono::nanoseconds timeout = chrono::nanoseconds::zero()) noexcept
+    {
+        if ((len == 0u) || (len > capacity()))
+            return false;
+
+        const uint32_t t_write = m_writeIndex.load(memory_order_relaxed);
+        const auto t_hasSpace = [this, t_write, len] {
+            return capacity() - (t_write - m_readIndex.load(memory_order_acquire)) >= len;
+        };
+
+        if (!AdaptiveWait::wait(m_readIndex, m_writersWaiting, t_hasSpace, timeout))
+            return false;
+
+        const uint32_t t_offset = t_write & m_mask;
+        const uint32_t t_first  = len < capacity() - t_offset ? len : capacity() - t_offset;
+        memcpy(m_buffer.data() + t_offset, pSrc, t_first*sizeof(T));
+        if (t_first < len)
+            memcpy(m_buffer.data(), pSrc + t_first, (len - t_first)*sizeof(T));
+
+        m_writeIndex.store(t_write + len, memory_order_release);
+        AdaptiveWait::wake(m_writeIndex, m_readersWaiting);
+
+        const uint32_t t_fill = t_write + len - m_readIndex.load(memory_order_relaxed);
+        if (t_fill > m_highWater.load(memory_order_relaxed))
+            m_highWater.store(t_fill, memory_order_relaxed);
+
+        return true;
+    }
+
+    /**
+     * \brief Чтение блока.
+     * \param pDst - буфер для данных.
+     * \param len - размер блока.
+     * \param timeout - максимальное время ожидания данных, 0 - без ожидания.
+     * \return false, если данных не появилось.
+     */
+    bool tryRead(T *pDst, uint32_t len, chrono::nanoseconds timeout = chrono::nanoseconds::zero()) noexcept
+    {
+        if ((len == 0u) || (len > capacity()))
+            return false;
+
+        const uint32_t t_read = m_readIndex.load(memory_order_relaxed);
+        const auto t_hasData = [this, t_read, len] {
+            return m_writeIndex.load(memory_order_acquire) - t_read >= len;
+        };
+
+        if (!AdaptiveWait::wait(m_writeIndex, m_readersWaiting, t_hasData, timeout))
+            return false;
+
+        const uint32_t t_offset = t_read & m_mask;
+        const uint32_t t_first  = len < capacity() - t_offset ? len : capacity() - t_offset;
+        memcpy(pDst, m_buffer.data() + t_offset, t_first*sizeof(T));
+        if (t_first < len)
+            memcpy(pDst + t_first, m_buffer.data(), (len - t_first)*sizeof(T));
+
+        m_readIndex.store(t_read + len, memory_order_release);
+        AdaptiveWait::wake(m_readIndex, m_writersWaiting);
+
+        return true;
+    }
+
+private:
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+private:
+    vector<T> m_buffer;
+    uint32_t  m_mask { 0 };
+
+    alignas(64) atomic<uint32_t> m_writeIndex     { 0 };
+    atomic<uint32_t>             m_readersWaiting { 0 };
+    atomic<uint32_t>             m_highWater      { 0 };     // пишет только писатель
+
+    alignas(64) atomic<uint32_t> m_readIndex      { 0 };
+    atomic<uint32_t>             m_writersWaiting { 0 };
+};
+
+}
+
+#endif // SPSCRINGBUFFER_H
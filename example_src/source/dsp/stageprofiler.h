@@ -0,0 +1,231 @@
+#ifndef STAGEPROFILER_H
+#define STAGEPROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace SDR {
+
+using namespace std;
+
+/**
+ * \class LatencyHistogram
+ * \brief Гистограмма длительностей с фиксированными интервалами.
+ *
+ * \details Интервалы логарифмические: каждая октава (степень двойки наносекунд)
+ * делится на 4 части, погрешность перцентиля не превышает 25%. Запись состоит из
+ * одного атомарного инкремента без блокировок, поэтому гистограмма может
+ * обновляться из потока реального времени и читаться из любого другого потока.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t SubBuckets  = 4;
+    static constexpr uint32_t Octaves     = 40;     // до ~18 минут
+    static constexpr uint32_t BucketCount = Octaves*SubBuckets;
+
+    LatencyHistogram() { reset(); }
+
+    /**
+     * \brief Добавление длительности в наносекундах.
+     */
+    void add(uint64_t ns) noexcept
+    {
+        m_buckets[index(ns)].fetch_add(1, memory_order_relaxed);
+        m_count.fetch_add(1, memory_order_relaxed);
+
+        uint64_t t_max = m_max.load(memory_order_relaxed);
+        while ((ns > t_max) && !m_max.compare_exchange_weak(t_max, ns, memory_order_relaxed));
+    }
+
+    uint64_t count() const noexcept { return m_count.load(memory_order_relaxed); }
+    uint64_t max() const noexcept   { return m_max.load(memory_order_relaxed); }
+
+    /**
+     * \brief Возвращает перцентиль в наносекундах.
+     * \param p - перцентиль в диапазоне 0..1.
+     * \return верхняя граница интервала, в который попал перцентиль.
+     */
+    uint64_t percentile(double p) const noexcept
+    {
+        array<uint64_t, BucketCount> t_buckets;
+        uint64_t t_total = 0;
+        for (uint32_t i = 0; i < BucketCount; ++i) {
+            t_buckets[i] = m_buckets[i].load(memory_order_relaxed);
+            t_total += t_buckets[i];
+        }
+
+        if (t_total == 0)
+            return 0;
+
+        const uint64_t t_rank = static_cast<uint64_t>(p*(t_total - 1)) + 1;
+        uint64_t t_sum = 0;
+        for (uint32_t i = 0; i < BucketCount; ++i) {
+            t_sum += t_buckets[i];
+            if (t_sum >= t_rank)
+                return min(upperBound(i), max());
+        }
+
+        return max();
+    }
+
+    void reset() noexcept
+    {
+        for (auto &bucket : m_buckets)
+            bucket.store(0, memory_order_relaxed);
+        m_count.store(0, memory_order_relaxed);
+        m_max.store(0, memory_order_relaxed);
+    }
+
+private:
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    static uint32_t index(uint64_t ns) noexcept
+    {
+        if (ns < SubBuckets)
+            return static_cast<uint32_t>(ns);
+
+#ifdef _MSC_VER
+        // _BitScanReverse64 недоступна в x32 сборке
+        uint32_t t_octave = 0;
+        for (uint64_t t_value = ns >> 1; t_value != 0; t_value >>= 1)
+            ++t_octave;
+#else
+        uint32_t t_octave = 63 - static_cast<uint32_t>(__builtin_clzll(ns));
+#endif
+        uint32_t t_sub    = static_cast<uint32_t>(ns >> (t_octave - 2)) & (SubBuckets - 1);
+        uint32_t t_index  = (t_octave - 1)*SubBuckets + t_sub;
+
+        return t_index < BucketCount ? t_index : BucketCount - 1;
+    }
+
+    static uint64_t upperBound(uint32_t index) noexcept
+    {
+        if (index < SubBuckets)
+            return index;
+
+        uint32_t t_octave = index/SubBuckets + 1;
+        uint32_t t_sub    = index%SubBuckets;
+
+        return ((SubBuckets + t_sub + 1) << (t_octave - 2)) - 1;
+    }
+
+private:
+    array<atomic<uint64_t>, BucketCount> m_buckets;
+    atomic<uint64_t> m_count;
+    atomic<uint64_t> m_max;
+};
+
+
+/**
+ * \brief Статистика одной ступени обработки, время в наносекундах.
+ */
+struct StageStatistics
+{
+    const char *name  { nullptr };
+    uint64_t    count { 0 };
+    uint64_t    p50   { 0 };
+    uint64_t    p99   { 0 };
+    uint64_t    max   { 0 };
+};
+
+
+/**
+ * \class StageProfiler
+ * \brief Набор гистограмм длительности для ступеней цепочки обработки.
+ *
+ * \details Время измеряется по steady_clock. Измерение выполняется объектом
+ * StageProfiler::Scope, который записывает длительность в деструкторе:
+ * \code
+ * {
+ *     SDR::StageProfiler::Scope t_scope(m_profiler, StageFft);
+ *     m_fft.process(m_signal, true);
+ * }
+ * \endcode
+ */
+class StageProfiler
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    class Scope
+    {
+    public:
+        Scope(StageProfiler &profiler, uint32_t stage) noexcept :
+          m_profiler(profiler),
+          m_stage(stage),
+          m_begin(Clock::now())
+        {}
+
+        ~Scope()
+        {
+            m_profiler.add(m_stage, Clock::now() - m_begin);
+        }
+
+    private:
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        StageProfiler     &m_profiler;
+        uint32_t           m_stage;
+        Clock::time_point  m_begin;
+    };
+
+    /**
+     * \brief Конструктор.
+     * \param names - имена ступеней, индекс имени является номером ступени.
+     */
+    explicit StageProfiler(const vector<const char*> &names) :
+      m_names(names),
+      m_histograms(names.size())
+    {}
+
+    uint32_t stages() const noexcept
+    {
+        return static_cast<uint32_t>(m_names.size());
+    }
+
+    void add(uint32_t stage, Clock::duration duration) noexcept
+    {
+        if (stage < m_histograms.size())
+            m_histograms[stage].add(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(duration).count()));
+    }
+
+    /**
+     * \brief Возвращает p50/p99/max для каждой ступени.
+     */
+    vector<StageStatistics> statistics() const
+    {
+        vector<StageStatistics> t_result(m_names.size());
+        for (size_t i = 0; i < m_names.size(); ++i) {
+            t_result[i].name  = m_names[i];
+            t_result[i].count = m_histograms[i].count();
+            t_result[i].p50   = m_histograms[i].percentile(0.50);
+            t_result[i].p99   = m_histograms[i].percentile(0.99);
+            t_result[i].max   = m_histograms[i].max();
+        }
+        return t_result;
+    }
+
+    void reset() noexcept
+    {
+        for (auto &histogram : m_histograms)
+            histogram.reset();
+    }
+
+private:
+    StageProfiler(const StageProfiler &) = delete;
+    StageProfiler &operator=(const StageProfiler &) = delete;
+
+private:
+    vector<const char*>      m_names;
+    vector<LatencyHistogram> m_histograms;
+};
+
+}
+
+#endif // STAGEPROFILER_H
@@ -0,0 +1,67 @@
+#ifndef STREAMALLOCATOR_H
+#define STREAMALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+#include "RingMemory.h"
+
+namespace SDR {
+
+/**
+ * \class StreamAllocator
+ * \brief Аллокатор для рабочих буферов потока (БПФ, спектр).
+ *
+ * \details Память выделяется через RingMemory::allocateBlock(): выравнивание 64 байта,
+ * все страницы затронуты при выделении и по возможности закреплены в памяти,
+ * поэтому первая обработка после start() не вызывает page fault.
+ * \code
+ * vector<Complex, SDR::StreamAllocator<Complex>> m_signal;
+ * \endcode
+ */
+template <typename T, uint32_t Flags = RingMemory::Prefault | RingMemory::Locked>
+class StreamAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = StreamAllocator<U, Flags>;
+    };
+
+    StreamAllocator() noexcept = default;
+
+    template <typename U>
+    StreamAllocator(const StreamAllocator<U, Flags> &) noexcept {}
+
+    T *allocate(size_t n)
+    {
+        void *p = RingMemory::allocateBlock(n*sizeof(T), Flags);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        RingMemory::releaseBlock(p);
+    }
+};
+
+template <typename T, typename U, uint32_t Flags>
+bool operator==(const StreamAllocator<T, Flags> &, const StreamAllocator<U, Flags> &) noexcept
+{
+    return true;
+}
+
+template <typename T, typename U, uint32_t Flags>
+bool operator!=(const StreamAllocator<T, Flags> &, const StreamAllocator<U, Flags> &) noexcept
+{
+    return false;
+}
+
+}
+
+#endif // STREAMALLOCATOR_H
@@ -40,6 +40,25 @@ public:
         }
     }
 
+    /**
+     * \brief Умножение участка сигнала на окно с копированием.
+     * \param pSrc - входной участок.
+     * \param pDst - выходной участок.
+     * \param offset - позиция участка в окне.
+     * \param len - длина участка.
+     */
+    void process(const Complex *pSrc, Complex *pDst, uint32_t offset, uint32_t len)
+    {
+        if (offset + len > m_vector.size())
+            return;
+
+        const Real *pWindow = m_vector.data() + offset;
+        for (uint32_t i = 0; i < len; ++i) {
+            pDst[i].re = pSrc[i].re*pWindow[i];
+            pDst[i].im = pSrc[i].im*pWindow[i];
+        }
+    }
+
 private:
     Window(const Window&) = delete;
     Window &operator=(const Window&) = delete;
@@ -52,6 +52,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 {
     Q_UNUSED(event);
 
+    m_control.reset();
     m_loader.finalize();
 }
 
@@ -64,11 +65,13 @@ void MainWindow::onOpen(bool state)
             return;
         }
 
-        m_loader.setFrequency(m_deskriptor, 1000000*sbFrequency->value());
-        m_loader.setPream(m_deskriptor, sbPreamp->value());
+        m_control.reset(new ControlQueue(m_loader, m_deskriptor));
+        m_control->apply(ControlUpdate().setFrequency(1000000*sbFrequency->value())
+                                        .setPream(sbPreamp->value()));
     }
     else {
         pbStart->setChecked(false);
+        m_control.reset();      // applies the queued values and joins the worker
         m_loader.stop(m_deskriptor);
         m_loader.close(m_deskriptor);
 
@@ -78,6 +81,10 @@ void MainWindow::onOpen(bool state)
 
 void MainWindow::onStart(bool state)
 {
+    // values queued by onOpen() reach the receiver before the stream starts
+    if (m_control)
+        m_control->flush();
+
     if (state) {
         DspCore::instance().open();
         m_loader.start(m_deskriptor,
@@ -93,12 +100,14 @@ void MainWindow::onStart(bool state)
 
 void MainWindow::onFrequency(double value)
 {
-    m_loader.setFrequency(m_deskriptor, 1000000*value);
+    if (m_control)
+        m_control->setFrequency(1000000*value);
 }
 
 void MainWindow::onPreamp(double value)
 {
-    m_loader.setPream(m_deskriptor, value);
+    if (m_control)
+        m_control->setPream(value);
 }
 
 void MainWindow::onSampleRate(int index)
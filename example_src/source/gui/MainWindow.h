@@ -8,6 +8,7 @@
 #include <QCustomPlot>
 #include "../LibLoader/common.h"
 #include "../LibLoader/LibLoader.h"
+#include "../LibLoader/ControlQueue.h"
 #include "../dsp/DspCore.h"
 #include "ui_MainWindow.h"
 
@@ -41,6 +42,7 @@ private:
 
     Descriptor m_deskriptor { nullptr };
     LibLoader  m_loader;
+    unique_ptr<ControlQueue> m_control;
 
     vector<Real> m_spectrum;
     QVector<double> m_x;